@@ -0,0 +1,90 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef ANIMATION_SCHEDULER_H
+#define ANIMATION_SCHEDULER_H
+
+#include "image.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+
+// singleton, advances every animated image from a single timer thread.
+// frames are due at absolute deadlines, the ones that are already late
+// when the timer wakes up are skipped
+class AnimationScheduler
+{
+  public:
+    using draw_t = std::function<void()>;
+
+    static auto instance() -> std::shared_ptr<AnimationScheduler>
+    {
+        static std::shared_ptr<AnimationScheduler> instance{new AnimationScheduler};
+        return instance;
+    }
+
+    AnimationScheduler(const AnimationScheduler &) = delete;
+    AnimationScheduler(AnimationScheduler &) = delete;
+    auto operator=(const AnimationScheduler &) -> AnimationScheduler & = delete;
+    auto operator=(AnimationScheduler &) -> AnimationScheduler & = delete;
+    ~AnimationScheduler();
+
+    // the current frame of image should already be on screen, draw is
+    // called on the timer thread every time the image moves to a new frame
+    auto add(Image *image, draw_t draw) -> uint64_t;
+    // once this returns draw is not running and won't be called again
+    void remove(uint64_t animation_id);
+    // called after the frames that were due together have been drawn,
+    // e.g. to send them all to a display server at once
+    auto add_tick_hook(draw_t hook) -> uint64_t;
+    void remove_tick_hook(uint64_t hook_id);
+
+  private:
+    using clock = std::chrono::steady_clock;
+
+    struct Animation {
+        Image *image = nullptr;
+        draw_t draw;
+        clock::time_point deadline;
+        // complete loops played so far
+        int plays = 0;
+        bool finished = false;
+    };
+
+    AnimationScheduler();
+
+    std::unordered_map<uint64_t, Animation> animations;
+    std::unordered_map<uint64_t, draw_t> tick_hooks;
+    uint64_t next_id = 0;
+    bool changed = false;
+
+    std::mutex animations_mutex;
+    std::mutex draw_mutex;
+    std::condition_variable_any animations_cond;
+    std::jthread timer;
+
+    void run(const std::stop_token &stoken);
+    auto advance(Animation &animation, clock::time_point now) -> bool;
+};
+
+#endif
@@ -19,12 +19,14 @@
 
 #include "canvas.hpp"
 #include "flags.hpp"
+#include "loader.hpp"
 #include "os.hpp"
 #include "terminal.hpp"
 #include "util/ptr.hpp"
 
 #include <atomic>
 #include <cstdlib>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <thread>
@@ -50,6 +52,8 @@ class Application
   private:
     std::unique_ptr<Terminal> terminal;
     std::unique_ptr<Canvas> canvas;
+    std::unique_ptr<ImageLoader> loader;
+    std::mutex canvas_mutex;
 
     std::shared_ptr<Flags> flags;
     std::shared_ptr<spdlog::logger> logger;
@@ -20,6 +20,7 @@
 #include <filesystem>
 #include <memory>
 #include <string>
+#include <vector>
 
 // singleton
 class Flags
@@ -48,6 +49,11 @@ class Flags
     bool origin_center = false;
     int32_t scale_factor = 1;
     bool needs_scaling = false;
+    int32_t mem_cache_size = 64;
+    int32_t anim_cache_size = 64;
+    std::string sixel_quality = "high";
+    // values accepted for sixel_quality, from the command line and the config file
+    inline static const std::vector<std::string> sixel_qualities{"high", "fast"};
 
     std::string cmd_id;
     std::string cmd_action;
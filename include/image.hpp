@@ -21,15 +21,24 @@
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <vector>
 
 #include "dimensions.hpp"
 #include "terminal.hpp"
 
+// result of moving an animation to its next frame
+enum class FrameStatus {
+    ready,
+    // the frame isn't decoded yet, try again shortly
+    pending,
+    // no more frames will come, e.g. the decoder failed
+    ended
+};
+
 class Image
 {
   public:
     static auto load(const nlohmann::json &command, const Terminal *terminal) -> std::unique_ptr<Image>;
-    static auto check_cache(const Dimensions &dimensions, const std::filesystem::path &orig_path) -> std::string;
     static auto get_dimensions(const nlohmann::json &json, const Terminal *terminal) -> std::shared_ptr<Dimensions>;
 
     virtual ~Image() = default;
@@ -41,14 +50,29 @@ class Image
     [[nodiscard]] virtual auto data() const -> const unsigned char * = 0;
     [[nodiscard]] virtual auto channels() const -> int = 0;
 
-    [[nodiscard]] virtual auto frame_delay() const -> int { return -1; }
     [[nodiscard]] virtual auto is_animated() const -> bool { return false; }
+    // delay in ms of every frame and number of times the animation plays, 0 for forever
+    [[nodiscard]] virtual auto frame_delays() const -> const std::vector<int> &
+    {
+        static const std::vector<int> no_delays;
+        return no_delays;
+    }
+    [[nodiscard]] virtual auto loop_count() const -> int { return 0; }
+    [[nodiscard]] virtual auto frame_index() const -> int { return 0; }
+    [[nodiscard]] auto frame_delay() const -> int;
     [[nodiscard]] virtual auto filename() const -> std::string = 0;
-    virtual auto next_frame() -> void {}
+    // advances to the next frame of an animation
+    virtual auto next_frame() -> FrameStatus { return FrameStatus::ended; }
 
   protected:
     [[nodiscard]] auto get_new_sizes(double max_width, double max_height, std::string_view scaler,
                                      int scale_factor = 0) const -> std::pair<int, int>;
+    static auto calculate_sizes(int img_width, int img_height, double max_width, double max_height,
+                                std::string_view scaler, int scale_factor = 0) -> std::pair<int, int>;
+
+  private:
+    static auto open(const std::shared_ptr<Dimensions> &dimensions, const std::string &image_path,
+                     const std::string &source, bool in_cache) -> std::unique_ptr<Image>;
 };
 
 #endif
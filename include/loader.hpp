@@ -0,0 +1,82 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include "image.hpp"
+#include "terminal.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <spdlog/fwd.h>
+
+// loads images on a pool of worker threads, only the latest
+// request of each identifier is handed to the callback.
+// prefetched images only warm up the caches, they run when no
+// other request is waiting and on one worker at a time
+class ImageLoader
+{
+  public:
+    using callback_t = std::function<void(const std::string &identifier, std::unique_ptr<Image> image)>;
+
+    ImageLoader(const Terminal *terminal, callback_t on_load);
+    ~ImageLoader();
+
+    void add(const std::string &identifier, const nlohmann::json &command);
+    void cancel(const std::string &identifier);
+    void prefetch(const nlohmann::json &command);
+
+  private:
+    struct Request {
+        std::string identifier;
+        nlohmann::json command;
+        uint64_t generation = 0;
+    };
+
+    const Terminal *terminal;
+    callback_t on_load;
+
+    std::deque<Request> requests;
+    std::deque<nlohmann::json> prefetches;
+    int running_prefetches = 0;
+    std::unordered_map<std::string, uint64_t> generations;
+    uint64_t next_generation = 0;
+
+    std::mutex queue_mutex;
+    std::mutex deliver_mutex;
+    std::condition_variable_any queue_cond;
+    std::vector<std::jthread> workers;
+
+    std::shared_ptr<spdlog::logger> logger;
+
+    void work(const std::stop_token &stoken);
+    void run_prefetch(const nlohmann::json &command);
+    void deliver(const Request &request, std::unique_ptr<Image> image);
+};
+
+#endif
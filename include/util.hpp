@@ -37,12 +37,13 @@ auto get_process_tree(int pid) -> std::vector<int>;
 auto get_process_tree_v2(int pid) -> std::vector<Process>;
 auto get_b2_hash_ssl(std::string_view str) -> std::string;
 auto get_cache_path() -> std::string;
-auto get_cache_file_save_location(const std::filesystem::path &path) -> std::string;
 auto get_log_filename() -> std::string;
 auto get_socket_path(int pid = os::get_pid()) -> std::string;
 void send_socket_message(std::string_view msg, std::string_view endpoint);
 auto base64_encode(const unsigned char *input, size_t length) -> std::string;
 void base64_encode_v2(const unsigned char *input, size_t length, unsigned char *out);
+auto base64_encoded_size(size_t length) -> size_t;
+void write_stdout(std::string_view data);
 void move_cursor(int row, int col);
 void save_cursor_position();
 void restore_cursor_position();
@@ -0,0 +1,55 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef UTIL_PIXEL_H
+#define UTIL_PIXEL_H
+
+#include <cstddef>
+#include <string_view>
+
+namespace util::pixel
+{
+
+enum class Order { rgb, bgr };
+
+// layout of the decoded pixels
+struct Format {
+    // 1 (gray), 2 (gray + alpha), 3 or 4
+    int channels = 4;
+    // bits per channel, 8 or 16
+    int depth = 8;
+    Order order = Order::rgb;
+};
+
+// layout expected by an output
+struct Target {
+    // 3 or 4
+    int channels = 4;
+    Order order = Order::rgb;
+    // multiply the colors by alpha, with 3 channels this flattens against black
+    bool premultiply = false;
+};
+
+[[nodiscard]] auto target_for(std::string_view output, bool has_alpha) -> Target;
+
+// depth reduction, premultiplication and channel swizzle in a single pass,
+// dst must hold count * target.channels bytes. src and dst may be the same
+// buffer only when both have four 8-bit channels
+void convert(const void *src, const Format &format, unsigned char *dst, const Target &target, size_t count);
+
+} // namespace util::pixel
+
+#endif
@@ -19,7 +19,9 @@
 
 #include <initializer_list>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <xcb/xcb.h>
@@ -37,6 +39,14 @@ class X11Util
     [[nodiscard]] auto get_parent_window(int pid) const -> xcb_window_t;
     [[nodiscard]] auto window_has_properties(xcb_window_t window, std::initializer_list<xcb_atom_t> properties) const
         -> bool;
+    // whether images can be uploaded through shared memory file descriptors
+    [[nodiscard]] auto has_shm() const -> bool;
+
+    // keep the pid map up to date from window events instead of walking the
+    // whole tree on every call, the events read from the connection must be
+    // passed to handle_event
+    void track_windows();
+    void handle_event(const xcb_generic_event_t *event);
 
     bool connected = false;
 
@@ -44,6 +54,27 @@ class X11Util
     xcb_connection_t *connection;
     xcb_screen_t *screen = nullptr;
     bool owns_connection = true;
+
+    bool tracking = false;
+    mutable bool indexed = false;
+    mutable std::mutex index_mutex;
+    struct TrackedWindow {
+        uint32_t pid = 0;
+        // walk order of the first index, then creation order
+        uint64_t order = 0;
+    };
+    mutable std::unordered_map<xcb_window_t, TrackedWindow> window_pids;
+    mutable uint64_t next_order = 0;
+    // created since the last lookup, or still without a class and name
+    mutable std::vector<xcb_window_t> pending_windows;
+
+    [[nodiscard]] auto query_pids(const std::vector<xcb_window_t> &windows) const
+        -> std::vector<std::pair<xcb_window_t, uint32_t>>;
+    [[nodiscard]] auto find_destroyed(const std::vector<xcb_window_t> &windows) const -> std::vector<xcb_window_t>;
+    [[nodiscard]] auto is_own_window(xcb_window_t window) const -> bool;
+    void index_windows() const;
+    void add_windows(const std::vector<xcb_window_t> &windows) const;
+    void resolve_pending_windows() const;
 };
 
 #endif
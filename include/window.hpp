@@ -26,6 +26,8 @@ public:
     virtual ~Window() = default;
     virtual void draw() = 0;
     virtual void generate_frame() = 0;
+    // for windows drawn in batches, the caller sends them all at once
+    virtual void generate_frame_batched() { generate_frame(); }
     virtual void show() {};
     virtual void hide() {};
 };
@@ -0,0 +1,182 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "animation.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+using std::chrono::milliseconds;
+
+AnimationScheduler::AnimationScheduler()
+    : timer([this](const std::stop_token &stoken) { run(stoken); })
+{
+}
+
+AnimationScheduler::~AnimationScheduler()
+{
+    timer.request_stop();
+    if (timer.joinable()) {
+        timer.join();
+    }
+}
+
+auto AnimationScheduler::add(Image *image, draw_t draw) -> uint64_t
+{
+    uint64_t animation_id = 0;
+    {
+        const std::scoped_lock lock{animations_mutex};
+        animation_id = ++next_id;
+        const auto deadline = clock::now() + milliseconds(image->frame_delay());
+        animations.insert_or_assign(
+            animation_id,
+            Animation{.image = image, .draw = std::move(draw), .deadline = deadline, .plays = 0, .finished = false});
+        changed = true;
+    }
+    animations_cond.notify_one();
+    return animation_id;
+}
+
+void AnimationScheduler::remove(uint64_t animation_id)
+{
+    // wait for a running draw
+    const std::scoped_lock draw_lock{draw_mutex};
+    const std::scoped_lock lock{animations_mutex};
+    animations.erase(animation_id);
+    changed = true;
+}
+
+auto AnimationScheduler::add_tick_hook(draw_t hook) -> uint64_t
+{
+    const std::scoped_lock lock{animations_mutex};
+    const auto hook_id = ++next_id;
+    tick_hooks.insert_or_assign(hook_id, std::move(hook));
+    return hook_id;
+}
+
+void AnimationScheduler::remove_tick_hook(uint64_t hook_id)
+{
+    const std::scoped_lock draw_lock{draw_mutex};
+    const std::scoped_lock lock{animations_mutex};
+    tick_hooks.erase(hook_id);
+}
+
+void AnimationScheduler::run(const std::stop_token &stoken)
+{
+    while (!stoken.stop_requested()) {
+        std::vector<uint64_t> due;
+        auto now = clock::now();
+        {
+            std::unique_lock lock{animations_mutex};
+            std::optional<clock::time_point> next_deadline;
+            for (const auto &[animation_id, animation] : animations) {
+                if (!animation.finished && (!next_deadline || animation.deadline < *next_deadline)) {
+                    next_deadline = animation.deadline;
+                }
+            }
+            changed = false;
+            if (!next_deadline) {
+                animations_cond.wait(lock, stoken, [this] { return changed; });
+                continue;
+            }
+            if (animations_cond.wait_until(lock, stoken, *next_deadline, [this] { return changed; })) {
+                // animations were added or removed, look for the earliest deadline again
+                continue;
+            }
+            now = clock::now();
+            for (const auto &[animation_id, animation] : animations) {
+                if (!animation.finished && animation.deadline <= now) {
+                    due.push_back(animation_id);
+                }
+            }
+        }
+
+        const std::scoped_lock draw_lock{draw_mutex};
+        bool drawn = false;
+        for (const auto animation_id : due) {
+            draw_t draw;
+            {
+                const std::scoped_lock lock{animations_mutex};
+                const auto found = animations.find(animation_id);
+                if (found == animations.end() || !advance(found->second, now)) {
+                    continue;
+                }
+                draw = found->second.draw;
+            }
+            draw();
+            drawn = true;
+        }
+        if (!drawn) {
+            continue;
+        }
+
+        std::vector<draw_t> hooks;
+        {
+            const std::scoped_lock lock{animations_mutex};
+            for (const auto &[hook_id, hook] : tick_hooks) {
+                hooks.push_back(hook);
+            }
+        }
+        for (const auto &hook : hooks) {
+            hook();
+        }
+    }
+}
+
+// moves the image to the frame that should be on screen now
+auto AnimationScheduler::advance(Animation &animation, clock::time_point now) -> bool
+{
+    // gifs commonly ask for delays shorter than what is reasonable to draw
+    const milliseconds min_delay{10};
+    // the frame decoder is behind, try again shortly
+    const milliseconds retry_delay{5};
+    // e.g. the system was suspended, don't try to catch up
+    const milliseconds max_lag{1000};
+
+    auto *image = animation.image;
+    const auto &delays = image->frame_delays();
+    const int last_frame = static_cast<int>(delays.size()) - 1;
+    const int loop_count = image->loop_count();
+
+    if (now - animation.deadline > max_lag) {
+        animation.deadline = now;
+    }
+    bool advanced = false;
+    while (animation.deadline <= now) {
+        if (loop_count > 0 && image->frame_index() == last_frame && animation.plays + 1 >= loop_count) {
+            // stay on the last frame
+            animation.finished = true;
+            break;
+        }
+        const auto status = image->next_frame();
+        if (status == FrameStatus::ended) {
+            // the frames decoded so far were shown, stay on the last one
+            animation.finished = true;
+            break;
+        }
+        if (status == FrameStatus::pending) {
+            animation.deadline = std::max(animation.deadline, now + retry_delay);
+            break;
+        }
+        advanced = true;
+        if (image->frame_index() == 0) {
+            ++animation.plays;
+        }
+        animation.deadline += std::max(milliseconds(delays.at(image->frame_index())), min_delay);
+    }
+    return advanced;
+}
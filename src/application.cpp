@@ -62,6 +62,17 @@ Application::Application(const char *executable)
         vips_error_exit(nullptr);
     }
     vips_cache_set_max(1);
+    loader = std::make_unique<ImageLoader>(terminal.get(),
+                                           [this](const std::string &identifier, std::unique_ptr<Image> image) {
+                                               const std::scoped_lock lock{canvas_mutex};
+                                               // runs on a loader thread, nothing may escape it
+                                               try {
+                                                   canvas->add_image(identifier, std::move(image));
+                                               } catch (const std::exception &err) {
+                                                   logger->error("Could not display image {}: {}", identifier,
+                                                                 err.what());
+                                               }
+                                           });
 }
 
 Application::~Application()
@@ -70,6 +81,7 @@ Application::~Application()
         socket_thread.join();
     }
     logger->info("Exiting ueberzugpp");
+    loader.reset();
     canvas.reset();
     vips_shutdown();
     tmux::unregister_hooks();
@@ -97,6 +109,10 @@ void Application::execute(const std::string_view cmd)
         handle_tmux_hook(hook);
         return;
     }
+    if (action == "prefetch") {
+        loader->prefetch(json);
+        return;
+    }
 
     const std::string &identifier = json.at("identifier");
     if (action == "add") {
@@ -104,13 +120,10 @@ void Application::execute(const std::string_view cmd)
             logger->error("Path received is not valid");
             return;
         }
-        auto image = Image::load(json, terminal.get());
-        if (!image) {
-            logger->error("Unable to load image file");
-            return;
-        }
-        canvas->add_image(identifier, std::move(image));
+        loader->add(identifier, json);
     } else if (action == "remove") {
+        loader->cancel(identifier);
+        const std::scoped_lock lock{canvas_mutex};
         canvas->remove_image(identifier);
     } else {
         logger->warn("Command not supported");
@@ -144,6 +157,7 @@ void Application::handle_tmux_hook(const std::string_view hook)
     };
 
     try {
+        const std::scoped_lock lock{canvas_mutex};
         hook_fns.at(hook)();
     } catch (const std::out_of_range &oor) {
         logger->warn("TMUX hook not recognized");
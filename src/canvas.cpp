@@ -17,7 +17,7 @@
 #include "canvas/chafa.hpp"
 #include "canvas/iterm2/iterm2.hpp"
 #include "canvas/kitty/kitty.hpp"
-#include "canvas/sixel.hpp"
+#include "canvas/sixel/sixel.hpp"
 #include "canvas/stdout.hpp"
 #ifdef ENABLE_X11
 #  include "canvas/x11/x11.hpp"
@@ -22,8 +22,12 @@
 
 #include <algorithm>
 #include <cmath>
-#include <iostream>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <utility>
 
+#include <fmt/format.h>
 #include <range/v3/all.hpp>
 #include <spdlog/spdlog.h>
 
@@ -32,73 +36,130 @@ void gstring_delete(GString *str)
     g_string_free(str, true);
 }
 
+namespace
+{
+
+// canvases are expensive to set up, windows of the same geometry share one
+struct CanvasCache {
+    std::mutex mutex;
+    // most recently used first
+    std::list<std::pair<std::pair<int, int>, ChafaCanvas *>> canvases;
+};
+
+auto get_cache() -> CanvasCache &
+{
+    static CanvasCache cache;
+    return cache;
+}
+
+} // namespace
+
 Chafa::Chafa(std::unique_ptr<Image> new_image, std::mutex *stdout_mutex)
-    : symbol_map(chafa_symbol_map_new()),
-      config(chafa_canvas_config_new()),
-      image(std::move(new_image)),
+    : image(std::move(new_image)),
       stdout_mutex(stdout_mutex)
 {
-    const auto envp = c_unique_ptr<gchar *, g_strfreev>{g_get_environ()};
-    term_info = chafa_term_db_detect(chafa_term_db_get_default(), envp.get());
-
     const auto dims = image->dimensions();
     x = dims.x + 1;
     y = dims.y + 1;
     horizontal_cells = std::ceil(static_cast<double>(image->width()) / dims.terminal->font_width);
     vertical_cells = std::ceil(static_cast<double>(image->height()) / dims.terminal->font_height);
-
-    chafa_symbol_map_add_by_tags(symbol_map, CHAFA_SYMBOL_TAG_BLOCK);
-    chafa_symbol_map_add_by_tags(symbol_map, CHAFA_SYMBOL_TAG_BORDER);
-    chafa_symbol_map_add_by_tags(symbol_map, CHAFA_SYMBOL_TAG_SPACE);
-    chafa_symbol_map_remove_by_tags(symbol_map, CHAFA_SYMBOL_TAG_WIDE);
-    chafa_canvas_config_set_symbol_map(config, symbol_map);
-    chafa_canvas_config_set_pixel_mode(config, CHAFA_PIXEL_MODE_SYMBOLS);
-    chafa_canvas_config_set_geometry(config, horizontal_cells, vertical_cells);
 }
 
 Chafa::~Chafa()
 {
-    chafa_canvas_unref(canvas);
-    chafa_canvas_config_unref(config);
-    chafa_symbol_map_unref(symbol_map);
-    chafa_term_info_unref(term_info);
-
     const std::scoped_lock lock{*stdout_mutex};
     util::clear_terminal_area(x, y, horizontal_cells, vertical_cells);
 }
 
+auto Chafa::get_term_info() -> ChafaTermInfo *
+{
+    static ChafaTermInfo *term_info = [] {
+        const auto envp = c_unique_ptr<gchar *, g_strfreev>{g_get_environ()};
+        return chafa_term_db_detect(chafa_term_db_get_default(), envp.get());
+    }();
+    return term_info;
+}
+
+// must be called with the cache locked
+auto Chafa::get_canvas(int width, int height) -> ChafaCanvas *
+{
+    auto &canvases = get_cache().canvases;
+    const auto geometry = std::make_pair(width, height);
+    const auto found = std::find_if(canvases.begin(), canvases.end(),
+                                    [&geometry](const auto &entry) { return entry.first == geometry; });
+    if (found != canvases.end()) {
+        canvases.splice(canvases.begin(), canvases, found);
+        return found->second;
+    }
+
+    static ChafaSymbolMap *symbol_map = [] {
+#ifdef CHAFA_VERSION_1_10
+        // symbol matching runs on every core
+        chafa_set_n_threads(static_cast<gint>(std::max(1U, std::thread::hardware_concurrency())));
+#endif
+        auto *map = chafa_symbol_map_new();
+        chafa_symbol_map_add_by_tags(map, CHAFA_SYMBOL_TAG_BLOCK);
+        chafa_symbol_map_add_by_tags(map, CHAFA_SYMBOL_TAG_BORDER);
+        chafa_symbol_map_add_by_tags(map, CHAFA_SYMBOL_TAG_SPACE);
+        chafa_symbol_map_remove_by_tags(map, CHAFA_SYMBOL_TAG_WIDE);
+        return map;
+    }();
+
+    auto *config = chafa_canvas_config_new();
+    chafa_canvas_config_set_symbol_map(config, symbol_map);
+    chafa_canvas_config_set_pixel_mode(config, CHAFA_PIXEL_MODE_SYMBOLS);
+    chafa_canvas_config_set_geometry(config, width, height);
+    auto *canvas = chafa_canvas_new(config);
+    chafa_canvas_config_unref(config);
+
+    const size_t max_canvases = 8;
+    canvases.emplace_front(geometry, canvas);
+    if (canvases.size() > max_canvases) {
+        chafa_canvas_unref(canvases.back().second);
+        canvases.pop_back();
+    }
+    return canvas;
+}
+
 void Chafa::draw()
 {
-    canvas = chafa_canvas_new(config);
-    chafa_canvas_draw_all_pixels(canvas, CHAFA_PIXEL_BGRA8_UNASSOCIATED, image->data(), image->width(), image->height(),
-                                 image->width() * 4);
+    auto &cache = get_cache();
+    {
+        const std::scoped_lock lock{cache.mutex};
+        auto *canvas = get_canvas(horizontal_cells, vertical_cells);
+        chafa_canvas_draw_all_pixels(canvas, CHAFA_PIXEL_BGRA8_UNASSOCIATED, image->data(), image->width(),
+                                     image->height(), image->width() * 4);
+        append_rows(canvas);
+    }
 
+    const std::scoped_lock lock{*stdout_mutex};
+    util::write_stdout(str);
+    str.clear();
+}
+
+// the rows with the cursor moves in between, drawn with a single write
+void Chafa::append_rows(ChafaCanvas *canvas)
+{
+    str.append("\0337");
+    auto ycoord = y;
 #ifdef CHAFA_VERSION_1_14
     GString **lines = nullptr;
     gint lines_length = 0;
 
-    chafa_canvas_print_rows(canvas, term_info, &lines, &lines_length);
-    auto ycoord = y;
-    const std::scoped_lock lock{*stdout_mutex};
-    util::save_cursor_position();
+    chafa_canvas_print_rows(canvas, get_term_info(), &lines, &lines_length);
     for (int i = 0; i < lines_length; ++i) {
         const auto line = c_unique_ptr<GString, gstring_delete>{lines[i]};
-        util::move_cursor(ycoord++, x);
-        std::cout << line->str;
+        str.append(fmt::format("\033[{};{}f", ycoord++, x));
+        str.append(line->str, line->len);
     }
     g_free(lines);
 #else
-    const auto result = c_unique_ptr<GString, gstring_delete>{chafa_canvas_print(canvas, term_info)};
-    auto ycoord = y;
+    const auto result = c_unique_ptr<GString, gstring_delete>{chafa_canvas_print(canvas, get_term_info())};
     const auto lines = util::str_split(result->str, "\n");
-
-    const std::scoped_lock lock{*stdout_mutex};
-    util::save_cursor_position();
     ranges::for_each(lines, [this, &ycoord](const std::string &line) {
-        util::move_cursor(ycoord++, x);
-        std::cout << line;
+        str.append(fmt::format("\033[{};{}f", ycoord++, x));
+        str.append(line);
     });
 #endif
-    std::cout << std::flush;
-    util::restore_cursor_position();
+    str.append("\0338");
 }
@@ -21,6 +21,8 @@
 #include "window.hpp"
 
 #include <memory>
+#include <mutex>
+#include <string>
 
 #include <chafa.h>
 
@@ -34,18 +36,18 @@ class Chafa : public Window
     void generate_frame() override{};
 
   private:
-    ChafaTermInfo *term_info = nullptr;
-    ChafaSymbolMap *symbol_map = nullptr;
-    ChafaCanvasConfig *config = nullptr;
-    ChafaCanvas *canvas = nullptr;
-
     std::unique_ptr<Image> image;
     std::mutex *stdout_mutex;
+    std::string str;
 
     int x;
     int y;
     int horizontal_cells = 0;
     int vertical_cells = 0;
+
+    static auto get_term_info() -> ChafaTermInfo *;
+    static auto get_canvas(int width, int height) -> ChafaCanvas *;
+    void append_rows(ChafaCanvas *canvas);
 };
 
 #endif
@@ -15,28 +15,26 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "iterm2.hpp"
-#include "chunk.hpp"
 #include "dimensions.hpp"
 #include "image.hpp"
 #include "terminal.hpp"
 #include "util.hpp"
+#include "util/ptr.hpp"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
-#include <iostream>
+#include <iterator>
+#include <numeric>
+#include <unordered_set>
 
 #include <fmt/format.h>
 #include <spdlog/spdlog.h>
+#include <vips/vips8>
 
-#ifdef HAVE_STD_EXECUTION_H
-#  include <execution>
-#else
-#  include <oneapi/tbb.h>
-#endif
-
-#include <range/v3/all.hpp>
-
+using vips::VImage;
 namespace fs = std::filesystem;
 
 Iterm2::Iterm2(std::unique_ptr<Image> new_image, std::mutex *stdout_mutex)
@@ -58,51 +56,102 @@ Iterm2::~Iterm2()
 
 void Iterm2::draw()
 {
-    str.append("\033]1337;File=inline=1;");
+    const auto encoded = get_payload();
+    if (encoded.empty()) {
+        return;
+    }
     const auto filename = image->filename();
-    const auto num_bytes = fs::file_size(filename);
     const auto encoded_filename =
         util::base64_encode(reinterpret_cast<const unsigned char *>(filename.c_str()), filename.size());
-    str.append(fmt::format("size={};name={};width={}px;height={}px:", num_bytes, encoded_filename, image->width(),
-                           image->height()));
-
-    const int chunk_size = 1023;
-    const auto chunks = process_chunks(filename, chunk_size, num_bytes);
-    const int num_chunks = std::ceil(static_cast<double>(num_bytes) / chunk_size);
-    const uint64_t bytes_per_chunk = 4 * ((chunk_size + 2) / 3) + 100;
-    str.reserve((num_chunks + 2) * bytes_per_chunk);
 
-    ranges::for_each(chunks, [this](const std::unique_ptr<Iterm2Chunk> &chunk) { str.append(chunk->get_result()); });
-    str.append("\a");
+    str.append("\0337");
+    str.append(fmt::format("\033[{};{}f", y, x));
+    str.append(fmt::format("\033]1337;File=inline=1;size={};name={};width={}px;height={}px:", encoded.size(),
+                           encoded_filename, image->width(), image->height()));
+    const auto offset = str.size();
+    str.resize(offset + util::base64_encoded_size(encoded.size()));
+    util::base64_encode_v2(reinterpret_cast<const unsigned char *>(encoded.data()), encoded.size(),
+                           reinterpret_cast<unsigned char *>(str.data() + offset));
+    str.append("\a\0338");
 
     const std::scoped_lock lock{*stdout_mutex};
-    util::save_cursor_position();
-    util::move_cursor(y, x);
-    std::cout << str << std::flush;
-    util::restore_cursor_position();
+    util::write_stdout(str);
     str.clear();
 }
 
-auto Iterm2::process_chunks(const std::string &filename, int chunk_size, size_t num_bytes)
-    -> std::vector<std::unique_ptr<Iterm2Chunk>>
+// the terminal plays animated files itself, and a still file that is
+// already smaller than the encoded pixels is sent as it is
+auto Iterm2::get_payload() const -> std::string
 {
-    const int num_chunks = std::ceil(static_cast<double>(num_bytes) / chunk_size);
-    std::vector<std::unique_ptr<Iterm2Chunk>> chunks;
-    chunks.reserve(num_chunks + 2);
-
-    std::ifstream ifs(filename);
-    while (ifs.good()) {
-        auto chunk = std::make_unique<Iterm2Chunk>(chunk_size);
-        ifs.read(chunk->get_buffer(), chunk_size);
-        chunk->set_size(ifs.gcount());
-        chunks.push_back(std::move(chunk));
+    std::error_code err;
+    const auto file_size = fs::file_size(image->filename(), err);
+    if (image->is_animated() && !err) {
+        return read_file();
+    }
+    auto encoded = encode_image();
+    if (!err && (encoded.empty() || file_size < encoded.size())) {
+        return read_file();
     }
+    return encoded;
+}
+
+auto Iterm2::read_file() const -> std::string
+{
+    std::ifstream ifs(image->filename(), std::ios::binary);
+    return {std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+}
 
-#ifdef HAVE_STD_EXECUTION_H
-    std::for_each(std::execution::par_unseq, chunks.begin(), chunks.end(), Iterm2Chunk::process_chunk);
-#else
-    oneapi::tbb::parallel_for_each(chunks.begin(), chunks.end(), Iterm2Chunk());
-#endif
+// the resized pixels are sent instead of the file, so the output scales with
+// the size of the preview. few colors or transparency go as png, anything
+// else is most likely a photo and goes as jpeg
+auto Iterm2::encode_image() const -> std::string
+{
+    const bool lossless = image->channels() == 4 || has_few_colors();
+    try {
+        const auto pixels =
+            VImage::new_from_memory(image->data(), image->size(), image->width(), image->height(), image->channels(),
+                                    VIPS_FORMAT_UCHAR);
+        void *buf = nullptr;
+        size_t size = 0;
+        if (lossless) {
+            pixels.write_to_buffer(".png", &buf, &size, VImage::option()->set("compression", 1));
+        } else {
+            const int quality = 90;
+            pixels.write_to_buffer(".jpg", &buf, &size, VImage::option()->set("Q", quality));
+        }
+        const c_unique_ptr<void, g_free> buf_owner{buf};
+        return {static_cast<const char *>(buf), size};
+    } catch (const vips::VError &err) {
+        spdlog::get("main")->error("Could not encode image: {}", err.what());
+        return {};
+    }
+}
 
-    return chunks;
+// looks at a sample of the pixels, graphics and screenshots have few
+// distinct colors and compress better without loss. only called for
+// images without alpha, which util::pixel::target_for gives 3 channel rgb
+auto Iterm2::has_few_colors() const -> bool
+{
+    const size_t max_colors = 256;
+    const size_t max_samples = 4096;
+    const auto channels = static_cast<size_t>(image->channels());
+    const auto width = static_cast<size_t>(image->width());
+    const auto num_pixels = image->size() / channels;
+    // a stride coprime to the width visits a different column on every row,
+    // so stripes can't line up with the samples
+    auto step = std::max<size_t>(1, num_pixels / max_samples);
+    while (width > 1 && std::gcd(step, width) != 1) {
+        ++step;
+    }
+    const auto *data = image->data();
+
+    std::unordered_set<uint32_t> colors;
+    for (size_t pixel = 0; pixel < num_pixels; pixel += step) {
+        const auto *px = data + pixel * channels;
+        colors.insert((static_cast<uint32_t>(px[0]) << 16) | (static_cast<uint32_t>(px[1]) << 8) | px[2]);
+        if (colors.size() > max_colors) {
+            return false;
+        }
+    }
+    return true;
 }
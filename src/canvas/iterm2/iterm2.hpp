@@ -17,13 +17,12 @@
 #ifndef ITERM2_CANVAS_H
 #define ITERM2_CANVAS_H
 
-#include "chunk.hpp"
 #include "image.hpp"
 #include "window.hpp"
 
+#include <memory>
 #include <mutex>
 #include <string>
-#include <vector>
 
 class Iterm2 : public Window
 {
@@ -44,8 +43,10 @@ class Iterm2 : public Window
     int horizontal_cells = 0;
     int vertical_cells = 0;
 
-    static auto process_chunks(const std::string &filename, int chunk_size, size_t num_bytes)
-        -> std::vector<std::unique_ptr<Iterm2Chunk>>;
+    [[nodiscard]] auto get_payload() const -> std::string;
+    [[nodiscard]] auto read_file() const -> std::string;
+    [[nodiscard]] auto encode_image() const -> std::string;
+    [[nodiscard]] auto has_few_colors() const -> bool;
 };
 
 #endif
@@ -0,0 +1,78 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "idtable.hpp"
+
+auto KittyIdTable::acquire(const std::string &key) -> std::optional<uint32_t>
+{
+    const std::scoped_lock lock{table_mutex};
+    const auto found = index.find(key);
+    if (found == index.end()) {
+        return {};
+    }
+    entries.splice(entries.begin(), entries, found->second);
+    found->second->users++;
+    return found->second->image_id;
+}
+
+auto KittyIdTable::insert(const std::string &key, uint32_t image_id, uint64_t size) -> Inserted
+{
+    // stay well below the storage quota of the terminal, which evicts images silently
+    const uint64_t max_bytes = 128 * 1024 * 1024;
+    Inserted res;
+    auto &evicted = res.evicted;
+
+    const std::scoped_lock lock{table_mutex};
+    const auto found = index.find(key);
+    if (found != index.end()) {
+        // another window transmitted the same image meanwhile and still shows it,
+        // its id stays until its last user releases it
+        if (found->second->users > 0) {
+            return res;
+        }
+        // transmitted again under a new id, the old data can go
+        evicted.push_back(found->second->image_id);
+        cur_bytes -= found->second->size;
+        entries.erase(found->second);
+        index.erase(found);
+    }
+    entries.push_front({.key = key, .image_id = image_id, .size = size, .users = 1});
+    index.insert_or_assign(key, entries.begin());
+    cur_bytes += size;
+
+    auto entry = entries.end();
+    while (cur_bytes > max_bytes && entry != entries.begin()) {
+        --entry;
+        if (entry->users > 0) {
+            continue;
+        }
+        evicted.push_back(entry->image_id);
+        cur_bytes -= entry->size;
+        index.erase(entry->key);
+        entry = entries.erase(entry);
+    }
+    res.recorded = true;
+    return res;
+}
+
+void KittyIdTable::release(const std::string &key)
+{
+    const std::scoped_lock lock{table_mutex};
+    const auto found = index.find(key);
+    if (found != index.end() && found->second->users > 0) {
+        found->second->users--;
+    }
+}
@@ -0,0 +1,77 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef KITTY_ID_TABLE_H
+#define KITTY_ID_TABLE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// singleton, images whose pixels were already transmitted to the terminal.
+// entries in use by a window are never evicted, the others are dropped least
+// recently used first once they exceed the byte budget
+class KittyIdTable
+{
+  public:
+    static auto instance() -> std::shared_ptr<KittyIdTable>
+    {
+        static std::shared_ptr<KittyIdTable> instance{new KittyIdTable};
+        return instance;
+    }
+
+    KittyIdTable(const KittyIdTable &) = delete;
+    KittyIdTable(KittyIdTable &) = delete;
+    auto operator=(const KittyIdTable &) -> KittyIdTable & = delete;
+    auto operator=(KittyIdTable &) -> KittyIdTable & = delete;
+
+    struct Inserted {
+        // false when a window still uses another id for the key, the caller
+        // then owns its image and must not call release
+        bool recorded = false;
+        // ids whose data should be freed
+        std::vector<uint32_t> evicted;
+    };
+
+    // id of the transmitted image, marks it as used until release is called
+    auto acquire(const std::string &key) -> std::optional<uint32_t>;
+    // records a transmitted image as used
+    auto insert(const std::string &key, uint32_t image_id, uint64_t size) -> Inserted;
+    void release(const std::string &key);
+
+  private:
+    KittyIdTable() = default;
+
+    struct Entry {
+        std::string key;
+        uint32_t image_id = 0;
+        uint64_t size = 0;
+        int users = 0;
+    };
+
+    // most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    uint64_t cur_bytes = 0;
+    std::mutex table_mutex;
+};
+
+#endif
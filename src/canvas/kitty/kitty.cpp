@@ -16,11 +16,26 @@
 
 #include "kitty.hpp"
 #include "dimensions.hpp"
+#include "idtable.hpp"
+#include "payload.hpp"
+#include "os.hpp"
 #include "util.hpp"
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <iostream>
+#include <numeric>
+#include <string_view>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #ifdef HAVE_STD_EXECUTION_H
 #  include <execution>
@@ -31,17 +46,44 @@
 Kitty::Kitty(std::unique_ptr<Image> new_image, std::mutex *stdout_mutex)
     : image(std::move(new_image)),
       stdout_mutex(stdout_mutex),
-      id(util::generate_random_number<uint32_t>(1))
+      table(KittyIdTable::instance()),
+      id(util::generate_random_number<uint32_t>(1)),
+      placement_id(util::generate_random_number<uint32_t>(1))
 {
     const auto dims = image->dimensions();
     x = dims.x + 1;
     y = dims.y + 1;
+    if (!image->is_animated()) {
+        key = get_key();
+    }
 }
 
 Kitty::~Kitty()
 {
+    // stops uploading frames before the image is deleted
+    uploader = std::jthread();
     const std::scoped_lock lock{*stdout_mutex};
-    std::cout << fmt::format("\033_Ga=d,d=i,i={}\033\\", id) << std::flush;
+    if (in_table) {
+        // the pixels stay in the terminal for the next window showing this image
+        std::cout << fmt::format("\033_Ga=d,d=i,i={},p={}\033\\", id, placement_id) << std::flush;
+        table->release(key);
+    } else {
+        std::cout << fmt::format("\033_Ga=d,d=I,i={}\033\\", id) << std::flush;
+    }
+}
+
+// identifies the pixels sent, the same file shown at the same size
+// produces the same key
+auto Kitty::get_key() const -> std::string
+{
+    const auto filename = image->filename();
+    std::error_code err;
+    const auto mtime = std::filesystem::last_write_time(filename, err);
+    if (err) {
+        return {};
+    }
+    return fmt::format("{}:{}:{}x{}:{}", filename, mtime.time_since_epoch().count(), image->width(), image->height(),
+                       image->channels());
 }
 
 void Kitty::draw()
@@ -51,56 +93,246 @@ void Kitty::draw()
 
 void Kitty::generate_frame()
 {
-    const int bits_per_channel = 8;
-    auto chunks = process_chunks();
-    str.append(fmt::format("\033_Ga=T,m=1,i={},q=2,f={},s={},v={};{}\033\\", id, image->channels() * bits_per_channel,
-                           image->width(), image->height(), chunks.front().get_result()));
+    // the terminal already plays the animation
+    if (uploader.joinable()) {
+        return;
+    }
+    if (!in_table && !key.empty()) {
+        const auto transmitted = table->acquire(key);
+        if (transmitted.has_value()) {
+            id = transmitted.value();
+            in_table = true;
+        }
+    }
+    // saves the cursor and moves it where the image goes, restored once drawn
+    str.append(fmt::format("\0337\033[{};{}f", y, x));
+    if (in_table) {
+        str.append(fmt::format("\033_Ga=p,i={},p={},q=2\033\\", id, placement_id));
+    } else {
+        append_transmit(fmt::format("a=T,i={},p={}", id, placement_id));
+        add_to_table();
+    }
+    str.append("\0338");
+
+    {
+        const std::scoped_lock lock{*stdout_mutex};
+        util::write_stdout(str);
+        str.clear();
+    }
 
-    for (auto chunk = std::next(std::begin(chunks)); chunk != std::prev(std::end(chunks)); std::advance(chunk, 1)) {
-        str.append("\033_Gm=1,q=2;");
-        str.append(chunk->get_result());
-        str.append("\033\\");
+    if (image->is_animated()) {
+        uploader = std::jthread([this](const std::stop_token &stoken) { upload_frames(stoken); });
     }
+}
+
+// the remaining frames are loaded into the terminal, which plays them on its own
+void Kitty::upload_frames(const std::stop_token &stoken)
+{
+    const auto &delays = image->frame_delays();
+    const int num_frames = static_cast<int>(delays.size());
+    const auto retry_delay = std::chrono::milliseconds(5);
+    // gap of the frame sent with the image
+    str.append(fmt::format("\033_Ga=a,i={},r=1,z={},q=2\033\\", id, image->frame_delay()));
 
-    str.append("\033_Gm=0,q=2;");
-    str.append(chunks.back().get_result());
-    str.append("\033\\");
+    int uploaded = 1;
+    while (uploaded < num_frames) {
+        if (stoken.stop_requested()) {
+            return;
+        }
+        const auto status = image->next_frame();
+        if (status == FrameStatus::ended) {
+            // the terminal loops over the frames it already has
+            break;
+        }
+        if (status == FrameStatus::pending) {
+            std::this_thread::sleep_for(retry_delay);
+            continue;
+        }
+        append_transmit(fmt::format("a=f,i={},z={}", id, image->frame_delay()));
+        const std::scoped_lock lock{*stdout_mutex};
+        util::write_stdout(str);
+        str.clear();
+        ++uploaded;
+    }
 
+    // 1 loops forever, n plays the animation n - 1 times
+    const int loops = image->loop_count() == 0 ? 1 : image->loop_count() + 1;
     const std::scoped_lock lock{*stdout_mutex};
-    util::save_cursor_position();
-    util::move_cursor(y, x);
-    std::cout << str << std::flush;
-    util::restore_cursor_position();
-    str.clear();
+    std::cout << fmt::format("\033_Ga=a,i={},s=3,v={},q=2\033\\", id, loops) << std::flush;
 }
 
-auto Kitty::process_chunks() -> std::vector<KittyChunk>
+void Kitty::add_to_table()
 {
-    const uint64_t chunk_size = 3068;
-    uint64_t num_chunks = image->size() / chunk_size;
-    uint64_t last_chunk_size = image->size() % chunk_size;
-    if (last_chunk_size == 0) {
-        last_chunk_size = chunk_size;
-        num_chunks--;
-    }
-    const uint64_t bytes_per_chunk = 4 * ((chunk_size + 2) / 3) + 100;
-    str.reserve((num_chunks + 2) * bytes_per_chunk);
-
-    std::vector<KittyChunk> chunks;
-    chunks.reserve(num_chunks + 2);
-    const auto *ptr = image->data();
+    if (key.empty()) {
+        return;
+    }
+    const auto inserted = table->insert(key, id, image->size());
+    in_table = inserted.recorded;
+    // free the pixels of images no window shows anymore once over budget
+    for (const auto evicted : inserted.evicted) {
+        str.append(fmt::format("\033_Ga=d,d=I,i={},q=2\033\\", evicted));
+    }
+}
+
+// control keys choose between transmitting a new image and adding a frame
+void Kitty::append_transmit(const std::string &control)
+{
+    const int bits_per_channel = 8;
+    const auto format = image->channels() * bits_per_channel;
+    const auto medium = get_medium();
 
-    uint64_t idx = 0;
-    for (; idx < num_chunks; idx++) {
-        chunks.emplace_back(ptr + idx * chunk_size, chunk_size);
+    // only the name of the shared memory object or file goes through the pty,
+    // the terminal removes it once read
+    std::optional<std::string> location;
+    char medium_key = 's';
+    if (medium == Medium::shared_memory) {
+        location = write_shared_memory();
+        if (!location.has_value()) {
+            location = write_temp_file();
+            medium_key = 't';
+        }
     }
-    chunks.emplace_back(ptr + idx * chunk_size, last_chunk_size);
 
+    if (location.has_value()) {
+        const auto &name = location.value();
+        str.append(fmt::format("\033_G{},t={},q=2,f={},s={},v={},S={};{}\033\\", control, medium_key, format,
+                               image->width(), image->height(), image->size(),
+                               util::base64_encode(reinterpret_cast<const unsigned char *>(name.c_str()), name.size())));
+    } else {
+        append_direct(control);
+    }
+}
+
+// shared memory and files only work when the terminal runs on this machine,
+// other terminals implementing the protocol may not support them
+auto Kitty::get_medium() -> Medium
+{
+    static const Medium medium = [] {
+        if (is_remote()) {
+            return Medium::direct;
+        }
+        const auto term = os::getenv("TERM").value_or("");
+        if (term == "xterm-kitty" || os::getenv("KITTY_WINDOW_ID").has_value()) {
+            return Medium::shared_memory;
+        }
+        return Medium::direct;
+    }();
+    return medium;
+}
+
+auto Kitty::is_remote() -> bool
+{
+    static const bool remote = [] {
+        for (const auto *var : {"SSH_CONNECTION", "SSH_CLIENT", "SSH_TTY"}) {
+            if (os::getenv(var).has_value()) {
+                return true;
+            }
+        }
+        return false;
+    }();
+    return remote;
+}
+
+auto Kitty::write_shared_memory() const -> std::optional<std::string>
+{
+    // names are limited to 31 characters on macos
+    const int name_len = 16;
+    const auto name = fmt::format("/ueberzugpp-{}", util::generate_random_string(name_len));
+    const int shm_fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if (shm_fd == -1) {
+        return {};
+    }
+    const auto size = image->size();
+    void *ptr = MAP_FAILED;
+    if (ftruncate(shm_fd, static_cast<off_t>(size)) == 0) {
+        ptr = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    }
+    close(shm_fd);
+    if (ptr == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return {};
+    }
+    std::memcpy(ptr, image->data(), size);
+    munmap(ptr, size);
+    return name;
+}
+
+auto Kitty::write_temp_file() const -> std::optional<std::string>
+{
+    // the terminal only deletes files that have this in their path
+    auto path = (std::filesystem::temp_directory_path() / "tty-graphics-protocol-ueberzugpp-XXXXXX").string();
+    const int file_fd = mkstemp(path.data());
+    if (file_fd == -1) {
+        return {};
+    }
+    const auto *ptr = image->data();
+    auto remaining = image->size();
+    while (remaining > 0) {
+        const auto written = write(file_fd, ptr, remaining);
+        if (written <= 0) {
+            close(file_fd);
+            unlink(path.c_str());
+            return {};
+        }
+        ptr += written;
+        remaining -= static_cast<size_t>(written);
+    }
+    close(file_fd);
+    return path;
+}
+
+// the escape codes and the encoded chunks are laid out in the final buffer
+// up front, then every chunk is encoded in parallel into its own place
+void Kitty::append_direct(const std::string &control)
+{
+    const KittyPayload payload(*image, is_remote());
+    const auto *ptr = payload.data();
+    const auto size = payload.size();
+
+    // the protocol accepts up to 4096 encoded bytes per chunk
+    const size_t chunk_size = 3072;
+    const size_t num_chunks = std::max<size_t>(1, (size + chunk_size - 1) / chunk_size);
+    const size_t last_size = size - (num_chunks - 1) * chunk_size;
+    const auto first = fmt::format("\033_G{},m={},q=2,{};", control, num_chunks > 1 ? 1 : 0, payload.keys());
+    const std::string_view middle = "\033_Gm=1,q=2;";
+    const std::string_view last = "\033_Gm=0,q=2;";
+    const std::string_view trailer = "\033\\";
+
+    const size_t full_stride = middle.size() + util::base64_encoded_size(chunk_size) + trailer.size();
+    const auto chunk_offset = [&](size_t idx) {
+        if (idx == 0) {
+            return size_t{0};
+        }
+        return first.size() + util::base64_encoded_size(chunk_size) + trailer.size() + (idx - 1) * full_stride;
+    };
+    const auto prefix_of = [&](size_t idx) -> std::string_view {
+        if (idx == 0) {
+            return first;
+        }
+        return idx + 1 == num_chunks ? last : middle;
+    };
+
+    const size_t start = str.size();
+    const auto last_idx = num_chunks - 1;
+    str.resize(start + chunk_offset(last_idx) + prefix_of(last_idx).size() + util::base64_encoded_size(last_size) +
+               trailer.size());
+    auto *out = str.data() + start;
+
+    std::vector<size_t> chunks(num_chunks);
+    std::iota(std::begin(chunks), std::end(chunks), 0);
+    const auto encode_chunk = [&](size_t idx) {
+        const auto prefix = prefix_of(idx);
+        const auto len = idx == last_idx ? last_size : chunk_size;
+        auto *dst = out + chunk_offset(idx);
+        std::memcpy(dst, prefix.data(), prefix.size());
+        dst += prefix.size();
+        util::base64_encode_v2(ptr + idx * chunk_size, len, reinterpret_cast<unsigned char *>(dst));
+        // also replaces the terminator the encoder may write
+        std::memcpy(dst + util::base64_encoded_size(len), trailer.data(), trailer.size());
+    };
 #ifdef HAVE_STD_EXECUTION_H
-    std::for_each(std::execution::par_unseq, std::begin(chunks), std::end(chunks), KittyChunk::process_chunk);
+    std::for_each(std::execution::par_unseq, std::begin(chunks), std::end(chunks), encode_chunk);
 #else
-    oneapi::tbb::parallel_for_each(std::begin(chunks), std::end(chunks), KittyChunk());
+    oneapi::tbb::parallel_for_each(std::begin(chunks), std::end(chunks), encode_chunk);
 #endif
-
-    return chunks;
 }
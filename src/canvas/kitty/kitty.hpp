@@ -17,13 +17,17 @@
 #ifndef KITTY_WINDOW_H
 #define KITTY_WINDOW_H
 
-#include "chunk.hpp"
 #include "image.hpp"
 #include "window.hpp"
 
 #include <memory>
 #include <mutex>
-#include <vector>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+class KittyIdTable;
 
 class Kitty : public Window
 {
@@ -35,14 +39,33 @@ class Kitty : public Window
     void generate_frame() override;
 
   private:
+    // how the pixels reach the terminal
+    enum class Medium { direct, shared_memory };
+
     std::string str;
     std::unique_ptr<Image> image;
     std::mutex *stdout_mutex;
+    std::shared_ptr<KittyIdTable> table;
     uint32_t id;
+    uint32_t placement_id;
     int x;
     int y;
 
-    auto process_chunks() -> std::vector<KittyChunk>;
+    // empty for images that are never reused
+    std::string key;
+    bool in_table = false;
+
+    std::jthread uploader;
+
+    static auto get_medium() -> Medium;
+    static auto is_remote() -> bool;
+    [[nodiscard]] auto get_key() const -> std::string;
+    void append_transmit(const std::string &control);
+    void add_to_table();
+    void upload_frames(const std::stop_token &stoken);
+    void append_direct(const std::string &control);
+    [[nodiscard]] auto write_shared_memory() const -> std::optional<std::string>;
+    [[nodiscard]] auto write_temp_file() const -> std::optional<std::string>;
 };
 
 #endif
@@ -0,0 +1,225 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "payload.hpp"
+
+#include <fmt/format.h>
+
+#define ZLIB_CONST
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#ifdef HAVE_STD_EXECUTION_H
+#  include <execution>
+#else
+#  include <oneapi/tbb.h>
+#endif
+
+namespace
+{
+
+// rough number of bytes per second a terminal reads escape codes at
+constexpr double local_rate = 128.0 * 1024 * 1024;
+constexpr double remote_rate = 4.0 * 1024 * 1024;
+
+// compressed independently, so every block can run on its own thread
+constexpr size_t block_size = 256 * 1024;
+// smaller images are sent before compression could pay off
+constexpr size_t min_deflate_size = 64 * 1024;
+
+struct Block {
+    const unsigned char *ptr = nullptr;
+    size_t size = 0;
+    bool last = false;
+    std::string out;
+    uLong adler = 0;
+};
+
+// raw deflate data ending on a byte boundary, blocks can be concatenated into
+// a single stream. out is left empty on failure
+void compress_block(Block &block)
+{
+    z_stream strm{};
+    if (deflateInit2(&strm, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+    }
+    // the bound doesn't count the marker of a sync flush
+    const size_t marker_size = 16;
+    block.out.resize(deflateBound(&strm, block.size) + marker_size);
+    strm.next_in = block.ptr;
+    strm.avail_in = static_cast<uInt>(block.size);
+    strm.next_out = reinterpret_cast<Bytef *>(block.out.data());
+    strm.avail_out = static_cast<uInt>(block.out.size());
+    const int res = deflate(&strm, block.last ? Z_FINISH : Z_SYNC_FLUSH);
+    const bool done = block.last ? res == Z_STREAM_END : res == Z_OK && strm.avail_in == 0;
+    block.out.resize(done ? strm.total_out : 0);
+    deflateEnd(&strm);
+    block.adler = adler32(adler32(0, nullptr, 0), block.ptr, static_cast<uInt>(block.size));
+}
+
+} // namespace
+
+KittyPayload::KittyPayload(const Image &image, bool remote)
+    : image(image)
+{
+    if (!read_png()) {
+        compress(remote);
+    }
+}
+
+auto KittyPayload::data() const -> const unsigned char *
+{
+    if (kind == Kind::raw) {
+        return image.data();
+    }
+    return reinterpret_cast<const unsigned char *>(buffer.data());
+}
+
+auto KittyPayload::size() const -> size_t
+{
+    if (kind == Kind::raw) {
+        return image.size();
+    }
+    return buffer.size();
+}
+
+auto KittyPayload::keys() const -> std::string
+{
+    if (kind == Kind::png) {
+        return "f=100";
+    }
+    const int bits_per_channel = 8;
+    return fmt::format("f={},s={},v={}{}", image.channels() * bits_per_channel, image.width(), image.height(),
+                       kind == Kind::deflate ? ",o=z" : "");
+}
+
+// the file can be sent as is when the pixels were decoded from it without resizing
+auto KittyPayload::read_png() -> bool
+{
+    if (image.is_animated()) {
+        return false;
+    }
+    const auto filename = image.filename();
+    std::ifstream ifs(filename, std::ios::binary);
+    const size_t header_size = 24;
+    std::array<unsigned char, header_size> header{};
+    if (!ifs.read(reinterpret_cast<char *>(header.data()), header_size)) {
+        return false;
+    }
+    const std::array<unsigned char, 8> signature{0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (!std::equal(signature.begin(), signature.end(), header.begin()) ||
+        std::memcmp(&header.at(12), "IHDR", 4) != 0) {
+        return false;
+    }
+    const auto read_be32 = [&header](size_t offset) {
+        return (static_cast<uint32_t>(header.at(offset)) << 24) | (static_cast<uint32_t>(header.at(offset + 1)) << 16) |
+               (static_cast<uint32_t>(header.at(offset + 2)) << 8) | static_cast<uint32_t>(header.at(offset + 3));
+    };
+    if (read_be32(16) != static_cast<uint32_t>(image.width()) ||
+        read_be32(20) != static_cast<uint32_t>(image.height())) {
+        return false;
+    }
+
+    std::error_code err;
+    const auto file_size = std::filesystem::file_size(filename, err);
+    if (err || file_size >= image.size()) {
+        return false;
+    }
+    buffer.resize(file_size);
+    ifs.seekg(0);
+    if (!ifs.read(buffer.data(), static_cast<std::streamsize>(file_size))) {
+        buffer.clear();
+        return false;
+    }
+    kind = Kind::png;
+    return true;
+}
+
+auto KittyPayload::compress(bool remote) -> bool
+{
+    const auto size = image.size();
+    if (size < min_deflate_size) {
+        return false;
+    }
+    const auto *ptr = image.data();
+    std::vector<Block> blocks((size + block_size - 1) / block_size);
+    for (size_t idx = 0; idx < blocks.size(); ++idx) {
+        auto &block = blocks.at(idx);
+        block.ptr = ptr + idx * block_size;
+        block.size = std::min(block_size, size - idx * block_size);
+        block.last = idx + 1 == blocks.size();
+    }
+
+    // the first block doubles as a sample of the time compression takes
+    // against the time it saves writing to the terminal
+    auto &first = blocks.front();
+    const auto start = std::chrono::steady_clock::now();
+    compress_block(first);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (first.out.empty()) {
+        return false;
+    }
+    const double ratio = static_cast<double>(first.out.size()) / static_cast<double>(first.size);
+    const double threads = std::max(1U, std::thread::hardware_concurrency());
+    const double compress_time = elapsed.count() * static_cast<double>(blocks.size() - 1) / threads;
+    // base64 makes every byte 4/3 bytes on the wire
+    const double saved_time =
+        (1.0 - ratio) * static_cast<double>(size) * 4 / 3 / (remote ? remote_rate : local_rate);
+    if (compress_time >= saved_time) {
+        return false;
+    }
+
+#ifdef HAVE_STD_EXECUTION_H
+    std::for_each(std::execution::par, std::next(std::begin(blocks)), std::end(blocks), compress_block);
+#else
+    oneapi::tbb::parallel_for_each(std::next(std::begin(blocks)), std::end(blocks), compress_block);
+#endif
+
+    size_t total = 0;
+    for (const auto &block : blocks) {
+        if (block.out.empty()) {
+            return false;
+        }
+        total += block.out.size();
+    }
+
+    // zlib header for a 32K window and the fastest level, adler32 trailer
+    const size_t header_size = 2;
+    const size_t trailer_size = 4;
+    buffer.reserve(header_size + total + trailer_size);
+    buffer.push_back('\x78');
+    buffer.push_back('\x01');
+    uLong adler = first.adler;
+    buffer.append(first.out);
+    for (auto block = std::next(std::begin(blocks)); block != std::end(blocks); std::advance(block, 1)) {
+        buffer.append(block->out);
+        adler = adler32_combine(adler, block->adler, static_cast<z_off_t>(block->size));
+    }
+    for (const int shift : {24, 16, 8, 0}) {
+        buffer.push_back(static_cast<char>((adler >> shift) & 0xffU));
+    }
+    kind = Kind::deflate;
+    return true;
+}
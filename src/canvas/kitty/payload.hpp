@@ -0,0 +1,49 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef KITTY_PAYLOAD_H
+#define KITTY_PAYLOAD_H
+
+#include "image.hpp"
+
+#include <cstddef>
+#include <string>
+
+// cheapest representation of an image sent through the pty: the png file
+// itself, the pixels compressed with zlib or the raw pixels
+class KittyPayload
+{
+  public:
+    // remote terminals are slower to write to, which makes compression worth more
+    KittyPayload(const Image &image, bool remote);
+
+    [[nodiscard]] auto data() const -> const unsigned char *;
+    [[nodiscard]] auto size() const -> size_t;
+    // format and compression keys of the transmit command
+    [[nodiscard]] auto keys() const -> std::string;
+
+  private:
+    enum class Kind { raw, png, deflate };
+
+    const Image &image;
+    Kind kind = Kind::raw;
+    std::string buffer;
+
+    auto read_png() -> bool;
+    auto compress(bool remote) -> bool;
+};
+
+#endif
@@ -0,0 +1,175 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "encoder.hpp"
+#include "util/ptr.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+
+#ifdef HAVE_STD_EXECUTION_H
+#  include <execution>
+#else
+#  include <oneapi/tbb.h>
+#endif
+
+namespace
+{
+
+constexpr int band_height = 6;
+// enough rows per task to amortize the color buffers
+constexpr int bands_per_task = 8;
+
+void append_number(std::string &out, int num)
+{
+    std::array<char, 16> buf{};
+    const auto res = std::to_chars(buf.begin(), buf.end(), num);
+    out.append(buf.data(), res.ptr);
+}
+
+// the sixels of one color across the band, repeated characters are run length encoded
+void append_sixels(std::string &out, const unsigned char *bits, int width)
+{
+    // blank sixels at the end of the line draw nothing
+    while (width > 0 && bits[width - 1] == 0) {
+        --width;
+    }
+    const int min_run = 4;
+    int x = 0;
+    while (x < width) {
+        const auto sixel = bits[x];
+        int run = 1;
+        while (x + run < width && bits[x + run] == sixel) {
+            ++run;
+        }
+        const char chr = static_cast<char>('?' + sixel);
+        if (run >= min_run) {
+            out.push_back('!');
+            append_number(out, run);
+            out.push_back(chr);
+        } else {
+            out.append(static_cast<size_t>(run), chr);
+        }
+        x += run;
+    }
+}
+
+void encode_bands(const unsigned char *indexed, int width, int height, int num_colors, int first_band,
+                  int last_band, std::string &out)
+{
+    const auto row_size = static_cast<size_t>(width);
+    std::vector<unsigned char> bits(static_cast<size_t>(num_colors) * row_size);
+    std::vector<bool> present(num_colors);
+    std::vector<int> used;
+    used.reserve(num_colors);
+    const int num_bands = (height + band_height - 1) / band_height;
+
+    for (int band = first_band; band < last_band; ++band) {
+        const int top = band * band_height;
+        const int rows = std::min(band_height, height - top);
+        for (int row = 0; row < rows; ++row) {
+            const auto *pixels = indexed + static_cast<size_t>(top + row) * row_size;
+            for (int x = 0; x < width; ++x) {
+                const auto color = pixels[x];
+                auto *color_bits = bits.data() + color * row_size;
+                if (!present[color]) {
+                    present[color] = true;
+                    used.push_back(color);
+                    std::memset(color_bits, 0, row_size);
+                }
+                color_bits[x] |= static_cast<unsigned char>(1U << row);
+            }
+        }
+
+        for (size_t idx = 0; idx < used.size(); ++idx) {
+            const auto color = used[idx];
+            out.push_back('#');
+            append_number(out, color);
+            append_sixels(out, bits.data() + color * row_size, width);
+            // back to the start of the band for the next color
+            if (idx + 1 < used.size()) {
+                out.push_back('$');
+            }
+            present[color] = false;
+        }
+        used.clear();
+        if (band + 1 < num_bands) {
+            out.push_back('-');
+        }
+    }
+}
+
+} // namespace
+
+void SixelEncoder::encode(const unsigned char *pixels, int width, int height, SixelPalette &palette, std::string &out)
+{
+    const auto size = static_cast<size_t>(width) * height * 3;
+    // dithering spreads the error over the input, keep the image intact
+    scratch.assign(pixels, pixels + size);
+
+    int num_colors = 0;
+    unique_C_ptr<unsigned char> indexed;
+    {
+        const std::scoped_lock lock{palette.mutex};
+        indexed.reset(sixel_dither_apply_palette(palette.dither, scratch.data(), width, height));
+        num_colors = sixel_dither_get_num_of_palette_colors(palette.dither);
+        if (indexed == nullptr) {
+            return;
+        }
+
+        out.append(fmt::format("\033Pq\"1;1;{};{}", width, height));
+        const auto *colors = sixel_dither_get_palette(palette.dither);
+        const int max_value = 255;
+        const int max_percent = 100;
+        for (int color = 0; color < num_colors; ++color) {
+            const auto *rgb = colors + static_cast<ptrdiff_t>(color) * 3;
+            const auto percent = [&](int channel) { return (rgb[channel] * max_percent + max_value / 2) / max_value; };
+            out.append(fmt::format("#{};2;{};{};{}", color, percent(0), percent(1), percent(2)));
+        }
+    }
+
+    const int num_bands = (height + band_height - 1) / band_height;
+    const int num_tasks = (num_bands + bands_per_task - 1) / bands_per_task;
+    outputs.resize(num_tasks);
+    std::vector<int> tasks(num_tasks);
+    std::iota(std::begin(tasks), std::end(tasks), 0);
+    const auto encode_task = [&](int task) {
+        auto &task_out = outputs.at(task);
+        task_out.clear();
+        const int first_band = task * bands_per_task;
+        encode_bands(indexed.get(), width, height, num_colors, first_band,
+                     std::min(num_bands, first_band + bands_per_task), task_out);
+    };
+#ifdef HAVE_STD_EXECUTION_H
+    // tasks allocate, which unsequenced execution doesn't allow
+    std::for_each(std::execution::par, std::begin(tasks), std::end(tasks), encode_task);
+#else
+    oneapi::tbb::parallel_for_each(std::begin(tasks), std::end(tasks), encode_task);
+#endif
+
+    for (const auto &task_out : outputs) {
+        out.append(task_out);
+    }
+    out.append("\033\\");
+}
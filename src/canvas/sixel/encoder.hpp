@@ -14,29 +14,25 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
-#ifndef KITTY_CHUNK_H
-#define KITTY_CHUNK_H
+#ifndef SIXEL_ENCODER_H
+#define SIXEL_ENCODER_H
 
+#include "palette.hpp"
+
+#include <string>
 #include <vector>
-#include <cstdint>
 
-class KittyChunk
+// quantizes rgb pixels with a libsixel palette, then encodes the bands of
+// six rows concurrently. buffers are kept between frames
+class SixelEncoder
 {
-public:
-    KittyChunk() = default;
-    KittyChunk(const unsigned char* ptr, uint64_t size);
-
-    void operator()(KittyChunk& chunk) const;
-
-    auto get_result() -> char*;
-    [[nodiscard]] auto get_ptr() const -> const unsigned char*;
-    [[nodiscard]] auto get_size() const -> uint64_t;
+  public:
+    // appends the escape sequence drawing the pixels to out
+    void encode(const unsigned char *pixels, int width, int height, SixelPalette &palette, std::string &out);
 
-    static void process_chunk(KittyChunk& chunk);
-private:
-    const unsigned char* ptr;
-    uint64_t size;
-    std::vector<char> result;
+  private:
+    std::vector<unsigned char> scratch;
+    std::vector<std::string> outputs;
 };
 
 #endif
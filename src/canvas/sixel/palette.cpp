@@ -0,0 +1,72 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "palette.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <filesystem>
+
+SixelPalette::~SixelPalette()
+{
+    sixel_dither_unref(dither);
+}
+
+auto SixelPalettes::get(const Image &image, bool fast) -> std::shared_ptr<SixelPalette>
+{
+    const auto filename = image.filename();
+    std::error_code err;
+    const auto mtime = std::filesystem::last_write_time(filename, err);
+    if (err) {
+        return build(image, fast);
+    }
+    const auto key =
+        fmt::format("{}:{}:{}x{}:{}", filename, mtime.time_since_epoch().count(), image.width(), image.height(), fast);
+
+    {
+        const std::scoped_lock lock{cache_mutex};
+        const auto found =
+            std::find_if(entries.begin(), entries.end(), [&key](const auto &entry) { return entry.first == key; });
+        if (found != entries.end()) {
+            entries.splice(entries.begin(), entries, found);
+            return found->second;
+        }
+    }
+
+    // quantizing is the slow part, other palettes can be looked up meanwhile
+    auto palette = build(image, fast);
+    const size_t max_entries = 16;
+    const std::scoped_lock lock{cache_mutex};
+    entries.emplace_front(key, palette);
+    if (entries.size() > max_entries) {
+        entries.pop_back();
+    }
+    return palette;
+}
+
+auto SixelPalettes::build(const Image &image, bool fast) -> std::shared_ptr<SixelPalette>
+{
+    auto palette = std::make_shared<SixelPalette>();
+    sixel_dither_new(&palette->dither, -1, nullptr);
+    sixel_dither_initialize(palette->dither, const_cast<unsigned char *>(image.data()), image.width(), image.height(),
+                            SIXEL_PIXELFORMAT_RGB888, SIXEL_LARGE_LUM, SIXEL_REP_CENTER_BOX,
+                            fast ? SIXEL_QUALITY_LOW : SIXEL_QUALITY_HIGH);
+    if (fast) {
+        sixel_dither_set_diffusion_type(palette->dither, SIXEL_DIFFUSE_NONE);
+    }
+    return palette;
+}
@@ -0,0 +1,71 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef SIXEL_PALETTE_H
+#define SIXEL_PALETTE_H
+
+#include "image.hpp"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <sixel.h>
+
+// dither and palette built from an image
+struct SixelPalette {
+    sixel_dither_t *dither = nullptr;
+    // libsixel keeps lookup tables inside the dither while encoding
+    std::mutex mutex;
+
+    SixelPalette() = default;
+    SixelPalette(const SixelPalette &) = delete;
+    auto operator=(const SixelPalette &) -> SixelPalette & = delete;
+    ~SixelPalette();
+};
+
+// singleton, palettes shared by the frames of an animation and by
+// every window showing the same image at the same size
+class SixelPalettes
+{
+  public:
+    static auto instance() -> std::shared_ptr<SixelPalettes>
+    {
+        static std::shared_ptr<SixelPalettes> instance{new SixelPalettes};
+        return instance;
+    }
+
+    SixelPalettes(const SixelPalettes &) = delete;
+    SixelPalettes(SixelPalettes &) = delete;
+    auto operator=(const SixelPalettes &) -> SixelPalettes & = delete;
+    auto operator=(SixelPalettes &) -> SixelPalettes & = delete;
+
+    // palette of the current pixels of the image, fast skips error diffusion
+    auto get(const Image &image, bool fast) -> std::shared_ptr<SixelPalette>;
+
+  private:
+    SixelPalettes() = default;
+
+    // most recently used first
+    std::list<std::pair<std::string, std::shared_ptr<SixelPalette>>> entries;
+    std::mutex cache_mutex;
+
+    static auto build(const Image &image, bool fast) -> std::shared_ptr<SixelPalette>;
+};
+
+#endif
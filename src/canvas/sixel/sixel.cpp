@@ -0,0 +1,122 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "sixel.hpp"
+#include "dimensions.hpp"
+#include "flags.hpp"
+#include "terminal.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+Sixel::Sixel(std::unique_ptr<Image> new_image, std::mutex *stdout_mutex)
+    : image(std::move(new_image)),
+      stdout_mutex(stdout_mutex)
+{
+    const auto dims = image->dimensions();
+    x = dims.x + 1;
+    y = dims.y + 1;
+    horizontal_cells = std::ceil(static_cast<double>(image->width()) / dims.terminal->font_width);
+    vertical_cells = std::ceil(static_cast<double>(image->height()) / dims.terminal->font_height);
+    font_height = dims.terminal->font_height;
+
+    const auto file_size = fs::file_size(image->filename());
+    constexpr auto reserve_ratio = 50;
+    str.reserve(file_size * reserve_ratio);
+
+    // frames of animations are drawn with the palette of the first one
+    palette = SixelPalettes::instance()->get(*image, Flags::instance()->sixel_quality == "fast");
+}
+
+Sixel::~Sixel()
+{
+    if (animation_id != 0) {
+        scheduler->remove(animation_id);
+    }
+
+    const std::scoped_lock lock{*stdout_mutex};
+    util::clear_terminal_area(x, y, horizontal_cells, vertical_cells);
+}
+
+void Sixel::draw()
+{
+    generate_frame();
+    if (image->is_animated()) {
+        scheduler = AnimationScheduler::instance();
+        animation_id = scheduler->add(image.get(), [this] { generate_frame(); });
+    }
+}
+
+void Sixel::generate_frame()
+{
+    const auto *data = image->data();
+    const auto stride = static_cast<size_t>(image->width()) * 3;
+    const auto [first_row, last_row] = changed_rows();
+    if (first_row == last_row) {
+        return;
+    }
+
+    encoder.encode(data + first_row * stride, image->width(), last_row - first_row, *palette, str);
+    if (image->is_animated()) {
+        previous.assign(data, data + image->size());
+    }
+
+    const std::scoped_lock lock{*stdout_mutex};
+    util::save_cursor_position();
+    util::move_cursor(y + first_row / font_height, x);
+    std::cout << str << std::flush;
+    util::restore_cursor_position();
+    str.clear();
+}
+
+// rows of the current frame that differ from the previous one. the range
+// starts on a cell boundary, where the cursor can be moved to, and spans
+// whole bands of six rows from there
+auto Sixel::changed_rows() const -> std::pair<int, int>
+{
+    const int height = image->height();
+    if (previous.size() != image->size()) {
+        return {0, height};
+    }
+    const auto stride = static_cast<size_t>(image->width()) * 3;
+    const auto *data = image->data();
+    const auto row_changed = [&](int row) {
+        const auto offset = static_cast<size_t>(row) * stride;
+        return std::memcmp(data + offset, previous.data() + offset, stride) != 0;
+    };
+
+    int first = 0;
+    while (first < height && !row_changed(first)) {
+        ++first;
+    }
+    if (first == height) {
+        return {0, 0};
+    }
+    int last = height;
+    while (!row_changed(last - 1)) {
+        --last;
+    }
+
+    const int band_height = 6;
+    first -= first % font_height;
+    last = std::min(height, first + util::round_up(last - first, band_height));
+    return {first, last};
+}
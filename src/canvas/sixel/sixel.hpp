@@ -17,17 +17,18 @@
 #ifndef SIXEL_WINDOW_H
 #define SIXEL_WINDOW_H
 
+#include "animation.hpp"
+#include "encoder.hpp"
 #include "image.hpp"
+#include "palette.hpp"
 #include "window.hpp"
 
-#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <mutex>
-#include <thread>
+#include <utility>
 #include <vector>
 
-#include <sixel.h>
-
 class Sixel : public Window
 {
   public:
@@ -42,16 +43,21 @@ class Sixel : public Window
     std::mutex *stdout_mutex;
 
     std::string str;
-    std::thread draw_thread;
-    std::atomic<bool> can_draw{true};
+    std::shared_ptr<AnimationScheduler> scheduler;
+    uint64_t animation_id = 0;
 
     int x;
     int y;
     int horizontal_cells = 0;
     int vertical_cells = 0;
+    int font_height = 1;
+
+    std::shared_ptr<SixelPalette> palette;
+    SixelEncoder encoder;
+    // pixels of the last frame drawn, only kept for animations
+    std::vector<unsigned char> previous;
 
-    sixel_dither_t *dither = nullptr;
-    sixel_output_t *output = nullptr;
+    [[nodiscard]] auto changed_rows() const -> std::pair<int, int>;
 };
 
 #endif
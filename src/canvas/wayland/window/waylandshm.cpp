@@ -27,8 +27,6 @@ constexpr struct xdg_surface_listener xdg_surface_listener = {
     .configure = WaylandShmWindow::xdg_surface_configure,
 };
 
-constexpr struct wl_callback_listener frame_listener = {.done = WaylandShmWindow::wl_surface_frame_done};
-
 void WaylandShmWindow::xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial)
 {
     xdg_surface_ack_configure(xdg_surface, serial);
@@ -41,25 +39,10 @@ void WaylandShmWindow::xdg_surface_configure(void *data, struct xdg_surface *xdg
     shm_window->wl_draw(shm_window->output_scale);
 }
 
-void WaylandShmWindow::wl_surface_frame_done(void *data, struct wl_callback *callback, [[maybe_unused]] uint32_t time)
-{
-    wl_callback_destroy(callback);
-    const auto *tmp = static_cast<struct XdgStruct *>(data);
-    const auto window = tmp->ptr.lock();
-    if (!window) {
-        return;
-    }
-    auto *shm_window = dynamic_cast<WaylandShmWindow *>(window.get());
-    const std::scoped_lock lock{shm_window->draw_mutex};
-    if (!shm_window->visible) {
-        return;
-    }
-    shm_window->generate_frame();
-}
-
 WaylandShmWindow::WaylandShmWindow(WaylandCanvas *canvas, std::unique_ptr<Image> new_image,
                                    struct XdgStructAgg *xdg_agg, WaylandConfig *config)
     : config(config),
+      display(canvas->display),
       xdg_base(canvas->xdg_base),
       surface(wl_compositor_create_surface(canvas->compositor)),
       xdg_surface(xdg_wm_base_get_xdg_surface(xdg_base, surface)),
@@ -83,17 +66,17 @@ void WaylandShmWindow::finish_init()
 
     setup_listeners();
     visible = true;
+
+    if (image->is_animated()) {
+        scheduler = AnimationScheduler::instance();
+        animation_id = scheduler->add(image.get(), [this] { generate_frame(); });
+    }
 }
 
 void WaylandShmWindow::setup_listeners()
 {
     xdg_surface_add_listener(xdg_surface, &xdg_surface_listener, this_ptr);
     wl_surface_commit(surface);
-
-    if (image->is_animated()) {
-        callback = wl_surface_frame(surface);
-        wl_callback_add_listener(callback, &frame_listener, this_ptr);
-    }
 }
 
 void WaylandShmWindow::xdg_setup()
@@ -104,6 +87,9 @@ void WaylandShmWindow::xdg_setup()
 
 WaylandShmWindow::~WaylandShmWindow()
 {
+    if (animation_id != 0) {
+        scheduler->remove(animation_id);
+    }
     delete_xdg_structs();
     delete_wayland_structs();
 }
@@ -172,15 +158,16 @@ void WaylandShmWindow::move_window()
     config->move_window(appid, xcoord, ycoord);
 }
 
+// called by the animation scheduler once the image moved to a new frame
 void WaylandShmWindow::generate_frame()
 {
-    std::this_thread::sleep_for(std::chrono::milliseconds(image->frame_delay()));
-    callback = wl_surface_frame(surface);
-    wl_callback_add_listener(callback, &frame_listener, this_ptr);
-
-    image->next_frame();
+    const std::scoped_lock lock{draw_mutex};
+    if (!visible) {
+        return;
+    }
     std::memcpy(shm->pool_data, image->data(), image->size());
     wl_surface_attach(surface, shm->buffer, 0, 0);
     wl_surface_damage_buffer(surface, 0, 0, image->width(), image->height());
     wl_surface_commit(surface);
+    wl_display_flush(display);
 }
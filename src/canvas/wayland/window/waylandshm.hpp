@@ -18,12 +18,14 @@
 #define WAYLAND_SHM_WINDOW_H
 
 #include "../wayland.hpp"
+#include "animation.hpp"
 #include "image.hpp"
 #include "shm.hpp"
 #include "wayland-xdg-shell-client-protocol.h"
 #include "waylandwindow.hpp"
 
 #include <atomic>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -36,7 +38,6 @@ class WaylandShmWindow : public WaylandWindow
                      WaylandConfig *config);
     ~WaylandShmWindow() override;
     static void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface, uint32_t serial);
-    static void wl_surface_frame_done(void *data, struct wl_callback *callback, uint32_t time);
 
     void draw() override {}
     void wl_draw(int32_t scale_factor) override;
@@ -54,14 +55,16 @@ class WaylandShmWindow : public WaylandWindow
   private:
     WaylandConfig *config;
 
+    struct wl_display *display = nullptr;
     struct xdg_wm_base *xdg_base = nullptr;
     struct wl_surface *surface = nullptr;
     struct xdg_surface *xdg_surface = nullptr;
     struct xdg_toplevel *xdg_toplevel = nullptr;
-    struct wl_callback *callback;
 
     std::unique_ptr<Image> image;
     std::string appid;
+    std::shared_ptr<AnimationScheduler> scheduler;
+    uint64_t animation_id = 0;
 
     struct XdgStructAgg *xdg_agg;
     void *this_ptr;
@@ -16,21 +16,30 @@
 
 #include "x11.hpp"
 #include "dimensions.hpp"
+#include "util.hpp"
 
+#include <array>
+#include <cstring>
 #include <string_view>
 
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <xcb/xcb.h>
 
 constexpr std::string_view win_name = "ueberzugpp";
 
 X11Window::X11Window(xcb_connection_t *connection, xcb_screen_t *screen, xcb_window_t window, xcb_window_t parent,
-                     std::shared_ptr<Image> image)
+                     std::shared_ptr<Image> image, bool use_shm)
     : connection(connection),
       screen(screen),
       window(window),
       parent(parent),
       gc(xcb_generate_id(connection)),
-      image(std::move(image))
+      image(std::move(image)),
+      use_shm(use_shm)
 {
     logger = spdlog::get("X11");
     create();
@@ -39,16 +48,14 @@ X11Window::X11Window(xcb_connection_t *connection, xcb_screen_t *screen, xcb_win
 
 void X11Window::create()
 {
-    const uint32_t value_mask = XCB_CW_BACK_PIXEL | XCB_CW_BORDER_PIXEL | XCB_CW_EVENT_MASK | XCB_CW_COLORMAP;
+    // no exposure events, the server repaints the window from its background pixmap
+    const uint32_t value_mask = XCB_CW_BACK_PIXEL | XCB_CW_BORDER_PIXEL | XCB_CW_COLORMAP;
     struct xcb_create_window_value_list_t value_list;
     value_list.background_pixel = screen->black_pixel;
     value_list.border_pixel = screen->black_pixel;
-    value_list.event_mask = XCB_EVENT_MASK_EXPOSURE;
     value_list.colormap = screen->default_colormap;
 
-    const auto dimensions = image->dimensions();
-    const auto xcoord = static_cast<int16_t>(dimensions.xpixels() + dimensions.padding_horizontal);
-    const auto ycoord = static_cast<int16_t>(dimensions.ypixels() + dimensions.padding_vertical);
+    const auto [xcoord, ycoord] = position();
     xcb_create_window_aux(connection, screen->root_depth, window, this->parent, xcoord, ycoord, image->width(),
                           image->height(), 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, value_mask,
                           &value_list);
@@ -57,6 +64,46 @@ void X11Window::create()
     logger->debug("Created child window {} at ({},{}) with parent {}", window, xcoord, ycoord, parent);
 }
 
+auto X11Window::position() const -> std::pair<int16_t, int16_t>
+{
+    const auto dimensions = image->dimensions();
+    return std::make_pair(static_cast<int16_t>(dimensions.xpixels() + dimensions.padding_horizontal),
+                          static_cast<int16_t>(dimensions.ypixels() + dimensions.padding_vertical));
+}
+
+void X11Window::reuse(std::shared_ptr<Image> new_image)
+{
+    const bool same_size = new_image->width() == image->width() && new_image->height() == image->height();
+    image = std::move(new_image);
+    if (!same_size && pixmap != 0) {
+        xcb_free_pixmap(connection, pixmap);
+        pixmap = 0;
+    }
+    // smaller images still fit in the segment
+    if (image->size() > shm_size) {
+        detach_shm();
+    }
+
+    const auto [xcoord, ycoord] = position();
+    const uint16_t value_mask =
+        XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT;
+    const std::array<uint32_t, 4> values{static_cast<uint32_t>(xcoord), static_cast<uint32_t>(ycoord),
+                                         static_cast<uint32_t>(image->width()),
+                                         static_cast<uint32_t>(image->height())};
+    xcb_configure_window(connection, window, value_mask, values.data());
+    logger->debug("Reusing child window {} at ({},{}) with parent {}", window, xcoord, ycoord, parent);
+}
+
+auto X11Window::id() const -> xcb_window_t
+{
+    return window;
+}
+
+auto X11Window::parent_window() const -> xcb_window_t
+{
+    return parent;
+}
+
 void X11Window::change_title()
 {
     const int bits_in_char = 8;
@@ -84,36 +131,128 @@ void X11Window::hide()
     xcb_flush(connection);
 }
 
-void X11Window::draw()
+// exposed areas are painted by the server from the background pixmap
+void X11Window::draw() {}
+
+void X11Window::generate_frame()
+{
+    generate_frame_batched();
+    xcb_flush(connection);
+}
+
+// every frame is uploaded once into a pixmap on the server, which then
+// becomes the window background
+void X11Window::generate_frame_batched()
+{
+    const auto width = static_cast<uint16_t>(image->width());
+    const auto height = static_cast<uint16_t>(image->height());
+    if (pixmap == 0) {
+        pixmap = xcb_generate_id(connection);
+        xcb_create_pixmap(connection, screen->root_depth, pixmap, window, width, height);
+    }
+
+    if (use_shm && attach_shm()) {
+        wait_for_shm();
+        std::memcpy(shm_data, image->data(), image->size());
+        shm_put = xcb_shm_put_image_checked(connection, pixmap, gc, width, height, 0, 0, width, height, 0, 0,
+                                            screen->root_depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 0, shmseg, 0);
+        shm_put_pending = true;
+    } else {
+        const auto xcb_image = c_unique_ptr<xcb_image_t, xcb_image_destroy>{
+            xcb_image_create_native(connection, width, height, XCB_IMAGE_FORMAT_Z_PIXMAP, screen->root_depth, nullptr,
+                                    image->size(), const_cast<unsigned char *>(image->data()))};
+        xcb_image_put(connection, pixmap, gc, xcb_image.get(), 0, 0, 0);
+    }
+
+    // set again, servers may copy the pixmap instead of referencing it
+    const uint32_t background = pixmap;
+    xcb_change_window_attributes(connection, window, XCB_CW_BACK_PIXMAP, &background);
+    xcb_clear_area(connection, 0, window, 0, 0, 0, 0);
+}
+
+// the segment lives as long as the window, new frames only send a small
+// request instead of the pixels
+auto X11Window::attach_shm() -> bool
+{
+    if (shm_data != nullptr) {
+        return true;
+    }
+    // falls back to sending the pixels for the rest of the window's life
+    use_shm = false;
+
+    const int name_len = 16;
+    const auto name = fmt::format("/ueberzugpp-{}", util::generate_random_string(name_len));
+    const int shm_fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if (shm_fd == -1) {
+        return false;
+    }
+    shm_unlink(name.c_str());
+
+    const auto size = image->size();
+    void *ptr = MAP_FAILED;
+    if (ftruncate(shm_fd, static_cast<off_t>(size)) == 0) {
+        ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    }
+    if (ptr == MAP_FAILED) {
+        close(shm_fd);
+        return false;
+    }
+
+    // xcb closes the descriptor once it is sent
+    const auto seg = xcb_generate_id(connection);
+    const auto cookie = xcb_shm_attach_fd_checked(connection, seg, shm_fd, 0);
+    const auto err = unique_C_ptr<xcb_generic_error_t>{xcb_request_check(connection, cookie)};
+    if (err) {
+        logger->debug("Could not attach shared memory to window {}, error {}", window, err->error_code);
+        munmap(ptr, size);
+        return false;
+    }
+
+    shmseg = seg;
+    shm_data = static_cast<unsigned char *>(ptr);
+    shm_size = size;
+    use_shm = true;
+    logger->debug("Attached shared memory segment {} to window {}", shmseg, window);
+    return true;
+}
+
+// the segment must not be written until the server is done with the
+// previous upload, which is only waited for right before the next one
+void X11Window::wait_for_shm()
 {
-    if (!xcb_image) {
+    if (!shm_put_pending) {
         return;
     }
-    xcb_image_put(connection, window, gc, xcb_image.get(), 0, 0, 0);
+    shm_put_pending = false;
+    const auto err = unique_C_ptr<xcb_generic_error_t>{xcb_request_check(connection, shm_put)};
+    if (err) {
+        logger->debug("Could not upload through shared memory to window {}, error {}", window, err->error_code);
+    }
 }
 
-void X11Window::generate_frame()
+void X11Window::detach_shm()
 {
-    xcb_image.reset(xcb_image_create_native(connection, image->width(), image->height(), XCB_IMAGE_FORMAT_Z_PIXMAP,
-                                            screen->root_depth, nullptr, 0, nullptr));
-    xcb_image->data = const_cast<unsigned char *>(image->data());
-    send_expose_event();
+    if (shm_data == nullptr) {
+        return;
+    }
+    // detaching is ordered after the upload on the server, no need to wait
+    if (shm_put_pending) {
+        xcb_discard_reply(connection, shm_put.sequence);
+        shm_put_pending = false;
+    }
+    xcb_shm_detach(connection, shmseg);
+    munmap(shm_data, shm_size);
+    shm_data = nullptr;
+    shm_size = 0;
 }
 
 X11Window::~X11Window()
 {
+    detach_shm();
     xcb_destroy_window(connection, window);
+    if (pixmap != 0) {
+        xcb_free_pixmap(connection, pixmap);
+    }
     xcb_free_gc(connection, gc);
     xcb_flush(connection);
 }
-
-void X11Window::send_expose_event()
-{
-    const int event_size = 32;
-    std::array<char, event_size> buffer;
-    auto *event = reinterpret_cast<xcb_expose_event_t *>(buffer.data());
-    event->response_type = XCB_EXPOSE;
-    event->window = window;
-    xcb_send_event(connection, 0, window, XCB_EVENT_MASK_EXPOSURE, reinterpret_cast<char *>(event));
-    xcb_flush(connection);
-}
@@ -21,6 +21,7 @@
 #include "util/ptr.hpp"
 #include "window.hpp"
 
+#include <xcb/shm.h>
 #include <xcb/xcb_image.h>
 #include <spdlog/spdlog.h>
 
@@ -30,14 +31,21 @@ class X11Window : public Window
 {
 public:
     X11Window(xcb_connection_t* connection, xcb_screen_t *screen,
-            xcb_window_t window, xcb_window_t parent, std::shared_ptr<Image> image);
+            xcb_window_t window, xcb_window_t parent, std::shared_ptr<Image> image, bool use_shm);
     ~X11Window() override;
 
     void draw() override;
     void generate_frame() override;
+    void generate_frame_batched() override;
     void show() override;
     void hide() override;
 
+    // moves and resizes the window for another image, which is uploaded with
+    // the next frame
+    void reuse(std::shared_ptr<Image> new_image);
+    [[nodiscard]] auto id() const -> xcb_window_t;
+    [[nodiscard]] auto parent_window() const -> xcb_window_t;
+
 private:
     xcb_connection_t *connection;
     xcb_screen_t *screen;
@@ -46,13 +54,24 @@ private:
     xcb_window_t parent;
     xcb_gcontext_t gc;
 
-    c_unique_ptr<xcb_image_t, xcb_image_destroy> xcb_image;
+    xcb_pixmap_t pixmap = 0;
     std::shared_ptr<spdlog::logger> logger;
     std::shared_ptr<Image> image;
 
     bool visible = false;
 
-    void send_expose_event();
+    bool use_shm;
+    xcb_shm_seg_t shmseg = 0;
+    unsigned char *shm_data = nullptr;
+    size_t shm_size = 0;
+    // the last upload from the segment, the server reads it asynchronously
+    xcb_void_cookie_t shm_put = {0};
+    bool shm_put_pending = false;
+
+    auto attach_shm() -> bool;
+    void detach_shm();
+    void wait_for_shm();
+    [[nodiscard]] auto position() const -> std::pair<int16_t, int16_t>;
     void create();
     void change_title();
 };
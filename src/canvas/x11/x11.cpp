@@ -58,16 +58,26 @@ X11Canvas::X11Canvas()
 #endif
 
     xutil = std::make_unique<X11Util>(connection);
+    shm_available = xutil->has_shm();
+    xutil->track_windows();
+    scheduler = AnimationScheduler::instance();
+    // the frames of every animation due at once go out with a single flush
+    flush_hook = scheduler->add_tick_hook([this] { xcb_flush(connection); });
     logger = spdlog::get("X11");
     event_handler = std::thread(&X11Canvas::handle_events, this);
-    logger->info("Canvas created");
+    logger->info("Canvas created, shared memory {}", shm_available ? "available" : "unavailable");
 }
 
 X11Canvas::~X11Canvas()
 {
-    draw_threads.clear();
+    for (const auto &[identifier, animation_id] : animations) {
+        scheduler->remove(animation_id);
+    }
+    animations.clear();
+    scheduler->remove_tick_hook(flush_hook);
     windows.clear();
     image_windows.clear();
+    idle_windows.clear();
 
     if (event_handler.joinable()) {
         event_handler.join();
@@ -82,24 +92,20 @@ X11Canvas::~X11Canvas()
 
 void X11Canvas::draw(const std::string &identifier)
 {
-    if (!images.at(identifier)->is_animated()) {
-        for (const auto &[wid, window] : image_windows.at(identifier)) {
-            window->generate_frame();
-        }
+    const auto &image = images.at(identifier);
+    const auto &wins = image_windows.at(identifier);
+    for (const auto &[wid, window] : wins) {
+        window->generate_frame();
+    }
+    if (!image->is_animated()) {
         return;
     }
 
-    draw_threads.insert_or_assign(identifier, std::jthread([this, identifier](const std::stop_token &stoken) {
-                                      const auto image = images.at(identifier);
-                                      const auto wins = image_windows.at(identifier);
-                                      while (!stoken.stop_requested()) {
-                                          for (const auto &[wid, window] : wins) {
-                                              window->generate_frame();
-                                          }
-                                          image->next_frame();
-                                          std::this_thread::sleep_for(std::chrono::milliseconds(image->frame_delay()));
-                                      }
-                                  }));
+    animations.insert_or_assign(identifier, scheduler->add(image.get(), [wins] {
+                                    for (const auto &[wid, window] : wins) {
+                                        window->generate_frame_batched();
+                                    }
+                                }));
 }
 
 void X11Canvas::show()
@@ -137,7 +143,6 @@ void X11Canvas::handle_events()
             continue;
         }
 
-        const std::scoped_lock lock{windows_mutex};
         auto event = unique_C_ptr<xcb_generic_event_t>{xcb_poll_for_event(connection)};
         while (event) {
             const int real_event = event->response_type & ~event_mask;
@@ -149,6 +154,7 @@ void X11Canvas::handle_events()
                 }
                 case XCB_EXPOSE: {
                     const auto *expose = reinterpret_cast<xcb_expose_event_t *>(event.get());
+                    const std::scoped_lock lock{windows_mutex};
                     try {
                         logger->debug("Received expose event for window {}", expose->window);
                         const auto window = windows.at(expose->window);
@@ -158,6 +164,18 @@ void X11Canvas::handle_events()
                     }
                     break;
                 }
+                case XCB_CREATE_NOTIFY:
+                case XCB_DESTROY_NOTIFY:
+                case XCB_MAP_NOTIFY:
+                case XCB_UNMAP_NOTIFY:
+                case XCB_CONFIGURE_NOTIFY:
+                case XCB_REPARENT_NOTIFY:
+                case XCB_GRAVITY_NOTIFY:
+                case XCB_CIRCULATE_NOTIFY: {
+                    // selected on the root window to keep the pid map current
+                    xutil->handle_event(event.get());
+                    break;
+                }
                 default: {
                     logger->debug("Received unknown event {}", real_event);
                     break;
@@ -170,11 +188,15 @@ void X11Canvas::handle_events()
 
 void X11Canvas::add_image(const std::string &identifier, std::unique_ptr<Image> new_image)
 {
-    remove_image(identifier);
+    // the windows of the previous image stay mapped when they are reused
+    release_windows(identifier);
 
     logger->debug("Initializing canvas");
     images.insert({identifier, std::move(new_image)});
-    image_windows.insert({identifier, {}});
+    {
+        const std::scoped_lock lock{windows_mutex};
+        image_windows.insert({identifier, {}});
+    }
 
     const auto image = images.at(identifier);
     const auto dims = image->dimensions();
@@ -182,10 +204,11 @@ void X11Canvas::add_image(const std::string &identifier, std::unique_ptr<Image>
     get_tmux_window_ids(parent_ids);
 
     ranges::for_each(parent_ids, [this, &identifier, &image](xcb_window_t parent) {
-        const auto window_id = xcb_generate_id(connection);
+        auto window_id = xcb_window_t{0};
         std::shared_ptr<Window> window;
 #ifdef ENABLE_OPENGL
         if (egl_available) {
+            window_id = xcb_generate_id(connection);
             try {
                 window = std::make_shared<X11EGLWindow>(connection, screen, window_id, parent, egl.get(), image);
             } catch (const std::runtime_error &err) {
@@ -194,12 +217,24 @@ void X11Canvas::add_image(const std::string &identifier, std::unique_ptr<Image>
         }
 #endif
         if (window == nullptr) {
-            window = std::make_shared<X11Window>(connection, screen, window_id, parent, image);
+            auto idle_window = take_idle_window(parent);
+            if (idle_window != nullptr) {
+                idle_window->reuse(image);
+                window_id = idle_window->id();
+                window = std::move(idle_window);
+            } else {
+                window_id = xcb_generate_id(connection);
+                window = std::make_shared<X11Window>(connection, screen, window_id, parent, image, shm_available);
+            }
+        }
+        {
+            const std::scoped_lock lock{windows_mutex};
+            windows.insert({window_id, window});
+            image_windows.at(identifier).insert({window_id, window});
         }
-        windows.insert({window_id, window});
-        image_windows.at(identifier).insert({window_id, window});
         window->show();
     });
+    hide_idle_windows();
 
     draw(identifier);
 }
@@ -243,7 +278,17 @@ void X11Canvas::print_xcb_error(const xcb_generic_error_t *err)
 
 void X11Canvas::remove_image(const std::string &identifier)
 {
-    draw_threads.erase(identifier);
+    release_windows(identifier);
+    hide_idle_windows();
+}
+
+void X11Canvas::release_windows(const std::string &identifier)
+{
+    const auto animation = animations.find(identifier);
+    if (animation != animations.end()) {
+        scheduler->remove(animation->second);
+        animations.erase(animation);
+    }
     images.erase(identifier);
 
     const std::scoped_lock lock{windows_mutex};
@@ -251,7 +296,39 @@ void X11Canvas::remove_image(const std::string &identifier)
     if (old_windows.empty()) {
         return;
     }
+    const size_t max_idle_windows = 4;
     for (const auto &[key, value] : old_windows.mapped()) {
         windows.erase(key);
+        // EGL windows are still destroyed, their surface is tied to the image
+        auto x11_window = std::dynamic_pointer_cast<X11Window>(value);
+        if (x11_window == nullptr) {
+            continue;
+        }
+        auto &idle = idle_windows[x11_window->parent_window()];
+        if (idle.size() < max_idle_windows) {
+            idle.push_back(std::move(x11_window));
+        }
+    }
+}
+
+auto X11Canvas::take_idle_window(xcb_window_t parent) -> std::shared_ptr<X11Window>
+{
+    const std::scoped_lock lock{windows_mutex};
+    const auto found = idle_windows.find(parent);
+    if (found == idle_windows.end() || found->second.empty()) {
+        return nullptr;
+    }
+    auto window = std::move(found->second.back());
+    found->second.pop_back();
+    return window;
+}
+
+void X11Canvas::hide_idle_windows()
+{
+    const std::scoped_lock lock{windows_mutex};
+    for (const auto &[parent, idle] : idle_windows) {
+        for (const auto &window : idle) {
+            window->hide();
+        }
     }
 }
@@ -17,6 +17,7 @@
 #ifndef X11_CANVAS_H
 #define X11_CANVAS_H
 
+#include "animation.hpp"
 #include "canvas.hpp"
 #include "image.hpp"
 #include "window.hpp"
@@ -41,6 +42,7 @@
 #endif
 
 class Flags;
+class X11Window;
 
 class X11Canvas : public Canvas
 {
@@ -62,6 +64,7 @@ private:
 #endif
 
     std::unique_ptr<X11Util> xutil;
+    bool shm_available = false;
 
     // map for event handler
     std::unordered_map<xcb_window_t, std::shared_ptr<Window>> windows;
@@ -70,8 +73,14 @@ private:
     std::unordered_map<std::string,
         std::unordered_map<xcb_window_t, std::shared_ptr<Window>>> image_windows;
 
+    // hidden windows per parent, moved and resized for the next image
+    // instead of being destroyed and created again
+    std::unordered_map<xcb_window_t, std::vector<std::shared_ptr<X11Window>>> idle_windows;
+
     std::unordered_map<std::string, std::shared_ptr<Image>> images;
-    std::unordered_map<std::string, std::jthread> draw_threads;
+    std::shared_ptr<AnimationScheduler> scheduler;
+    std::unordered_map<std::string, uint64_t> animations;
+    uint64_t flush_hook = 0;
 
     std::thread event_handler;
     std::mutex windows_mutex;
@@ -88,6 +97,9 @@ private:
     void handle_events();
     void get_tmux_window_ids(std::unordered_set<xcb_window_t>& windows);
     void print_xcb_error(const xcb_generic_error_t* err);
+    void release_windows(const std::string& identifier);
+    void hide_idle_windows();
+    auto take_idle_window(xcb_window_t parent) -> std::shared_ptr<X11Window>;
 };
 
 #endif
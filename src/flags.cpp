@@ -17,6 +17,7 @@
 #include "flags.hpp"
 #include "os.hpp"
 
+#include <algorithm>
 #include <fmt/format.h>
 #include <fstream>
 #include <nlohmann/json.hpp>
@@ -48,4 +49,12 @@ void Flags::read_config_file()
     no_cache = layer.value("no-cache", false);
     no_opencv = layer.value("no-opencv", false);
     use_opengl = layer.value("opengl", false);
+    mem_cache_size = layer.value("mem-cache-size", mem_cache_size);
+    anim_cache_size = layer.value("anim-cache-size", anim_cache_size);
+    const auto quality = layer.value("sixel-quality", sixel_quality);
+    if (std::ranges::find(sixel_qualities, quality) != sixel_qualities.end()) {
+        sixel_quality = quality;
+    } else {
+        fmt::print(stderr, "Ignoring invalid sixel-quality \"{}\" in {}\n", quality, config_file.string());
+    }
 }
@@ -20,7 +20,10 @@
 #endif
 #include "dimensions.hpp"
 #include "flags.hpp"
+#include "image/cached.hpp"
+#include "image/cacheindex.hpp"
 #include "image/libvips.hpp"
+#include "image/memcache.hpp"
 #include "util.hpp"
 
 #ifdef ENABLE_OPENCV
@@ -47,17 +50,42 @@ auto Image::load(const njson &command, const Terminal *terminal) -> std::unique_
         logger->error("Could not parse dimensions from command");
         return nullptr;
     }
+
+    auto mem_cache = ImageMemCache::instance();
+    const auto cache_key = ImageMemCache::make_key(filename, *dimensions);
+    if (cache_key.has_value()) {
+        const auto entry = mem_cache->get(cache_key.value());
+        if (entry) {
+            logger->debug("Image found in memory cache");
+            return std::make_unique<CachedImage>(dimensions, entry);
+        }
+    }
+
     std::string image_path = filename;
     bool in_cache = false;
     if (!flags->no_cache) {
-        image_path = check_cache(*dimensions, filename);
-        in_cache = image_path != filename;
+        const auto cached = CacheIndex::instance()->lookup(filename, *dimensions);
+        if (cached.has_value()) {
+            image_path = cached->location;
+            in_cache = cached->exact;
+        }
     }
 
+    auto image = open(dimensions, image_path, filename, in_cache);
+    if (image && !image->is_animated() && cache_key.has_value()) {
+        mem_cache->put(cache_key.value(), *image);
+    }
+    return image;
+}
+
+auto Image::open(const std::shared_ptr<Dimensions> &dimensions, const std::string &image_path,
+                 const std::string &source, bool in_cache) -> std::unique_ptr<Image>
+{
+    const auto flags = Flags::instance();
 #ifdef ENABLE_OPENCV
     if (cv::haveImageReader(image_path) && !flags->no_opencv) {
         try {
-            return std::make_unique<OpencvImage>(dimensions, image_path, in_cache);
+            return std::make_unique<OpencvImage>(dimensions, image_path, source, in_cache);
         } catch (const std::runtime_error &) {
             return nullptr;
         }
@@ -66,7 +94,7 @@ auto Image::load(const njson &command, const Terminal *terminal) -> std::unique_
     const auto *vips_loader = vips_foreign_find_load(image_path.c_str());
     if (vips_loader != nullptr) {
         try {
-            return std::make_unique<LibvipsImage>(dimensions, image_path, in_cache);
+            return std::make_unique<LibvipsImage>(dimensions, image_path, source, in_cache);
         } catch (const vips::VError &) {
             return nullptr;
         }
@@ -74,37 +102,26 @@ auto Image::load(const njson &command, const Terminal *terminal) -> std::unique_
     return nullptr;
 }
 
-auto Image::check_cache(const Dimensions &dimensions, const fs::path &orig_path) -> std::string
+// delay of the frame on screen, -1 for still images
+auto Image::frame_delay() const -> int
 {
-    const fs::path cache_path = util::get_cache_file_save_location(orig_path);
-    if (!fs::exists(cache_path)) {
-        return orig_path;
+    const auto &delays = frame_delays();
+    const auto index = static_cast<size_t>(frame_index());
+    if (index >= delays.size()) {
+        return -1;
     }
-
-    vips::VImage cache_img;
-    try {
-        cache_img = vips::VImage::new_from_file(cache_path.c_str());
-    } catch (const vips::VError &) {
-        return orig_path;
-    }
-    const uint32_t img_width = cache_img.width();
-    const uint32_t img_height = cache_img.height();
-    const uint32_t dim_width = dimensions.max_wpixels();
-    const uint32_t dim_height = dimensions.max_hpixels();
-    const int delta = 10;
-
-    if ((dim_width >= img_width && dim_height >= img_height) &&
-        ((dim_width - img_width) <= delta || (dim_height - img_height) <= delta)) {
-        return cache_path;
-    }
-    return orig_path;
+    return delays[index];
 }
 
 auto Image::get_new_sizes(double max_width, double max_height, std::string_view scaler, int scale_factor) const
     -> std::pair<int, int>
 {
-    int img_width = width();
-    int img_height = height();
+    return calculate_sizes(width(), height(), max_width, max_height, scaler, scale_factor);
+}
+
+auto Image::calculate_sizes(int img_width, int img_height, double max_width, double max_height,
+                            std::string_view scaler, int scale_factor) -> std::pair<int, int>
+{
     int new_width = 0;
     int new_height = 0;
     double new_scale = 0;
@@ -0,0 +1,70 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "cached.hpp"
+#include "dimensions.hpp"
+#include "flags.hpp"
+#include "terminal.hpp"
+
+#include <cmath>
+
+CachedImage::CachedImage(std::shared_ptr<Dimensions> new_dims, std::shared_ptr<const MemCacheEntry> entry)
+    : dims(std::move(new_dims)),
+      entry(std::move(entry))
+{
+    const auto flags = Flags::instance();
+    if (flags->origin_center) {
+        const double img_width = static_cast<double>(width()) / dims->terminal->font_width;
+        const double img_height = static_cast<double>(height()) / dims->terminal->font_height;
+        dims->x -= std::floor(img_width / 2);
+        dims->y -= std::floor(img_height / 2);
+    }
+}
+
+auto CachedImage::dimensions() const -> const Dimensions &
+{
+    return *dims;
+}
+
+auto CachedImage::filename() const -> std::string
+{
+    return entry->filename;
+}
+
+auto CachedImage::width() const -> int
+{
+    return entry->width;
+}
+
+auto CachedImage::height() const -> int
+{
+    return entry->height;
+}
+
+auto CachedImage::size() const -> size_t
+{
+    return entry->data.size();
+}
+
+auto CachedImage::data() const -> const unsigned char *
+{
+    return entry->data.data();
+}
+
+auto CachedImage::channels() const -> int
+{
+    return entry->channels;
+}
@@ -0,0 +1,353 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "cacheindex.hpp"
+#include "dimensions.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <fmt/format.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+using njson = nlohmann::json;
+
+namespace
+{
+constexpr std::string_view record_suffix = ".idx.json";
+
+// modification time and size of the source file, used to detect stale entries
+auto stat_source(const fs::path &source) -> std::optional<std::pair<int64_t, uint64_t>>
+{
+    std::error_code err;
+    const auto mtime = fs::last_write_time(source, err);
+    if (err) {
+        return {};
+    }
+    const auto size = fs::file_size(source, err);
+    if (err) {
+        return {};
+    }
+    return std::make_pair(static_cast<int64_t>(mtime.time_since_epoch().count()), static_cast<uint64_t>(size));
+}
+
+// the record of one source, exclusively locked while open
+class LockedRecord
+{
+  public:
+    LockedRecord(fs::path path, bool create)
+        : path(std::move(path))
+    {
+        const int flags = O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0);
+        // the record may be removed while waiting for the lock, which leaves
+        // the lock on a file nobody else will open
+        const int max_attempts = 4;
+        for (int attempt = 0; attempt < max_attempts; ++attempt) {
+            fd = open(this->path.c_str(), flags, S_IRUSR | S_IWUSR);
+            if (fd == -1) {
+                return;
+            }
+            if (flock(fd, LOCK_EX) == 0 && is_linked()) {
+                return;
+            }
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    ~LockedRecord()
+    {
+        // closing releases the lock
+        if (fd != -1) {
+            close(fd);
+        }
+    }
+
+    LockedRecord(const LockedRecord &) = delete;
+    LockedRecord(LockedRecord &&) = delete;
+    auto operator=(const LockedRecord &) -> LockedRecord & = delete;
+    auto operator=(LockedRecord &&) -> LockedRecord & = delete;
+
+    [[nodiscard]] auto valid() const -> bool { return fd != -1; }
+
+    [[nodiscard]] auto read() const -> std::optional<std::pair<std::string, CacheIndexEntry>>
+    {
+        struct stat file_stat {};
+        if (fstat(fd, &file_stat) == -1 || file_stat.st_size == 0) {
+            return {};
+        }
+        std::string contents(static_cast<size_t>(file_stat.st_size), 0);
+        size_t done = 0;
+        while (done < contents.size()) {
+            const auto count = pread(fd, contents.data() + done, contents.size() - done, static_cast<off_t>(done));
+            if (count == -1 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return {};
+            }
+            done += static_cast<size_t>(count);
+        }
+
+        try {
+            const auto json = njson::parse(contents);
+            CacheIndexEntry entry{
+                .mtime = json.at("mtime"), .size = json.at("size"), .format = json.at("format"), .tiers = {}};
+            for (const auto &tier : json.at("tiers")) {
+                entry.tiers.push_back(
+                    CacheTier{.width = tier.at("width"), .height = tier.at("height"), .file = tier.at("file")});
+            }
+            return std::make_pair(json.at("source").get<std::string>(), std::move(entry));
+        } catch (const njson::exception &ex) {
+            return {};
+        }
+    }
+
+    // written in place, readers wait for the lock
+    auto write(const std::string &source, const CacheIndexEntry &entry) const -> bool
+    {
+        auto tiers = njson::array();
+        for (const auto &tier : entry.tiers) {
+            tiers.push_back({{"width", tier.width}, {"height", tier.height}, {"file", tier.file}});
+        }
+        const njson json = {{"source", source},      {"mtime", entry.mtime}, {"size", entry.size},
+                            {"format", entry.format}, {"tiers", tiers}};
+        const auto contents = json.dump();
+        if (ftruncate(fd, 0) == -1) {
+            return false;
+        }
+        size_t done = 0;
+        while (done < contents.size()) {
+            const auto count = pwrite(fd, contents.data() + done, contents.size() - done, static_cast<off_t>(done));
+            if (count == -1 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                return false;
+            }
+            done += static_cast<size_t>(count);
+        }
+        return true;
+    }
+
+    void remove() const
+    {
+        std::error_code err;
+        fs::remove(path, err);
+    }
+
+  private:
+    fs::path path;
+    int fd = -1;
+
+    [[nodiscard]] auto is_linked() const -> bool
+    {
+        struct stat fd_stat {};
+        struct stat path_stat {};
+        return fstat(fd, &fd_stat) == 0 && stat(path.c_str(), &path_stat) == 0 && fd_stat.st_dev == path_stat.st_dev &&
+               fd_stat.st_ino == path_stat.st_ino;
+    }
+};
+} // namespace
+
+CacheIndex::CacheIndex()
+    : cache_dir(util::get_cache_path()),
+      logger(spdlog::get("main"))
+{
+    // replaced by the record files
+    std::error_code err;
+    fs::remove(cache_dir / "index.json", err);
+    pruner = std::jthread([this](const std::stop_token &stoken) { prune(stoken); });
+}
+
+auto CacheIndex::record_path(const fs::path &source) const -> fs::path
+{
+    return cache_dir / fmt::format("{}{}", util::get_b2_hash_ssl(source.string()), record_suffix);
+}
+
+auto CacheIndex::lookup(const fs::path &source, const Dimensions &dimensions) -> std::optional<CacheLookup>
+{
+    const auto stat = stat_source(source);
+    if (!stat.has_value()) {
+        return {};
+    }
+    const auto [mtime, size] = stat.value();
+
+    const LockedRecord record{record_path(source), false};
+    if (!record.valid()) {
+        return {};
+    }
+    auto stored = record.read();
+    if (!stored.has_value()) {
+        return {};
+    }
+    auto &entry = stored->second;
+    if (entry.mtime != mtime || entry.size != size) {
+        logger->debug("Discarding stale cache entry for {}", source.string());
+        remove_tiers(entry);
+        record.remove();
+        return {};
+    }
+
+    const int dim_width = dimensions.max_wpixels();
+    const int dim_height = dimensions.max_hpixels();
+    const int delta = 10;
+
+    // a tier that already fits the box can be used as is, otherwise the smallest
+    // tier that still exceeds the box scales down to the same size as the source
+    auto best = entry.tiers.end();
+    bool exact = false;
+    for (auto tier = entry.tiers.begin(); tier != entry.tiers.end(); ++tier) {
+        if ((dim_width >= tier->width && dim_height >= tier->height) &&
+            ((dim_width - tier->width) <= delta || (dim_height - tier->height) <= delta)) {
+            best = tier;
+            exact = true;
+            break;
+        }
+        if (tier->width <= dim_width && tier->height <= dim_height) {
+            continue;
+        }
+        if (best == entry.tiers.end() || (tier->width * tier->height) < (best->width * best->height)) {
+            best = tier;
+        }
+    }
+    if (best == entry.tiers.end()) {
+        return {};
+    }
+
+    const auto location = cache_dir / best->file;
+    if (!fs::exists(location)) {
+        remove_tier(entry, best);
+        record.write(stored->first, entry);
+        return {};
+    }
+    std::rotate(entry.tiers.begin(), best, std::next(best));
+    record.write(stored->first, entry);
+    logger->debug("Using {}x{} cache tier for {}", entry.tiers.front().width, entry.tiers.front().height,
+                  source.string());
+    return CacheLookup{.location = location.string(), .exact = exact};
+}
+
+auto CacheIndex::save_location(const fs::path &source, int width, int height) -> std::optional<std::string>
+{
+    const auto stat = stat_source(source);
+    if (!stat.has_value()) {
+        return {};
+    }
+    const auto [mtime, size] = stat.value();
+    const auto hash = util::get_b2_hash_ssl(fmt::format("{}:{}:{}", source.string(), mtime, size));
+    const auto filename = fmt::format("{}-{}x{}{}", hash, width, height, source.extension().string());
+    return (cache_dir / filename).string();
+}
+
+void CacheIndex::insert(const fs::path &source, const std::string &location, int width, int height)
+{
+    const auto stat = stat_source(source);
+    if (!stat.has_value()) {
+        return;
+    }
+    const auto [mtime, size] = stat.value();
+
+    const LockedRecord record{record_path(source), true};
+    if (!record.valid()) {
+        logger->debug("Could not open cache record for {}", source.string());
+        return;
+    }
+    auto stored = record.read();
+    if (stored.has_value() && (stored->second.mtime != mtime || stored->second.size != size)) {
+        remove_tiers(stored->second);
+        stored.reset();
+    }
+    if (!stored.has_value()) {
+        auto extension = source.extension().string();
+        if (!extension.empty()) {
+            extension.erase(0, 1);
+        }
+        stored.emplace(source.string(), CacheIndexEntry{.mtime = mtime, .size = size, .format = extension, .tiers = {}});
+    }
+
+    auto &entry = stored->second;
+    auto &tiers = entry.tiers;
+    const auto filename = fs::path(location).filename().string();
+    std::erase_if(tiers, [&filename](const CacheTier &tier) { return tier.file == filename; });
+    tiers.insert(tiers.begin(), CacheTier{.width = width, .height = height, .file = filename});
+
+    // keep the most recently used tiers only
+    const size_t max_tiers = 4;
+    while (tiers.size() > max_tiers) {
+        remove_tier(entry, std::prev(tiers.end()));
+    }
+    if (!record.write(stored->first, entry)) {
+        logger->debug("Could not write cache record for {}", source.string());
+    }
+}
+
+// drops the records, and their tiers, of sources that were deleted
+void CacheIndex::prune(const std::stop_token &stoken)
+{
+    try {
+        for (const auto &file : fs::directory_iterator(cache_dir)) {
+            if (stoken.stop_requested()) {
+                return;
+            }
+            if (!file.path().string().ends_with(record_suffix)) {
+                continue;
+            }
+            const LockedRecord record{file.path(), false};
+            if (!record.valid()) {
+                continue;
+            }
+            const auto stored = record.read();
+            std::error_code err;
+            // kept when the source can't be checked, e.g. without permission
+            if (stored.has_value() && (fs::exists(stored->first, err) || err)) {
+                continue;
+            }
+            if (stored.has_value()) {
+                logger->debug("Pruning cache entry for {}", stored->first);
+                remove_tiers(stored->second);
+            }
+            record.remove();
+        }
+    } catch (const fs::filesystem_error &err) {
+        logger->debug("Could not prune the cache: {}", err.what());
+    }
+}
+
+void CacheIndex::remove_tiers(const CacheIndexEntry &entry)
+{
+    std::error_code err;
+    for (const auto &tier : entry.tiers) {
+        fs::remove(cache_dir / tier.file, err);
+    }
+}
+
+void CacheIndex::remove_tier(CacheIndexEntry &entry, std::vector<CacheTier>::iterator tier)
+{
+    std::error_code err;
+    fs::remove(cache_dir / tier->file, err);
+    entry.tiers.erase(tier);
+}
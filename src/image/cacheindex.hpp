@@ -0,0 +1,88 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef IMAGE_CACHE_INDEX_H
+#define IMAGE_CACHE_INDEX_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/fwd.h>
+
+class Dimensions;
+
+struct CacheTier {
+    int width = 0;
+    int height = 0;
+    std::string file;
+};
+
+struct CacheIndexEntry {
+    int64_t mtime = 0;
+    uint64_t size = 0;
+    std::string format;
+    // most recently used first
+    std::vector<CacheTier> tiers;
+};
+
+struct CacheLookup {
+    std::string location;
+    // the tier already has the requested size, no resizing needed
+    bool exact = false;
+};
+
+// singleton, index of the resized images stored in the cache directory.
+// every source has its own record file next to its tiers, locked while it
+// is read and written so instances sharing the directory keep each other's
+// tiers. records of sources that no longer exist are pruned on startup
+class CacheIndex
+{
+  public:
+    static auto instance() -> std::shared_ptr<CacheIndex>
+    {
+        static std::shared_ptr<CacheIndex> instance{new CacheIndex};
+        return instance;
+    }
+
+    CacheIndex(const CacheIndex &) = delete;
+    CacheIndex(CacheIndex &) = delete;
+    auto operator=(const CacheIndex &) -> CacheIndex & = delete;
+    auto operator=(CacheIndex &) -> CacheIndex & = delete;
+
+    auto lookup(const std::filesystem::path &source, const Dimensions &dimensions) -> std::optional<CacheLookup>;
+    auto save_location(const std::filesystem::path &source, int width, int height) -> std::optional<std::string>;
+    void insert(const std::filesystem::path &source, const std::string &location, int width, int height);
+
+  private:
+    CacheIndex();
+
+    std::filesystem::path cache_dir;
+    std::shared_ptr<spdlog::logger> logger;
+    std::jthread pruner;
+
+    [[nodiscard]] auto record_path(const std::filesystem::path &source) const -> std::filesystem::path;
+    void prune(const std::stop_token &stoken);
+    void remove_tiers(const CacheIndexEntry &entry);
+    void remove_tier(CacheIndexEntry &entry, std::vector<CacheTier>::iterator tier);
+};
+
+#endif
@@ -0,0 +1,109 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "framebuffer.hpp"
+
+#include <exception>
+
+#include <spdlog/spdlog.h>
+
+FrameBuffer::FrameBuffer(int num_frames, std::shared_ptr<const Frame> first, decoder_t decoder,
+                         size_t loop_budget)
+    : num_frames(num_frames),
+      decoder(std::move(decoder)),
+      loop_budget(loop_budget),
+      loop_bytes(first->size),
+      keep_loop(loop_bytes <= loop_budget),
+      logger(spdlog::get("main"))
+{
+    if (keep_loop) {
+        loop.reserve(num_frames);
+        loop.push_back(std::move(first));
+    }
+    decode_thread = std::jthread([this](const std::stop_token &stoken) { decode(stoken); });
+}
+
+FrameBuffer::~FrameBuffer()
+{
+    decode_thread.request_stop();
+    if (decode_thread.joinable()) {
+        decode_thread.join();
+    }
+}
+
+auto FrameBuffer::next() -> std::pair<FrameStatus, std::shared_ptr<const Frame>>
+{
+    const std::scoped_lock lock{buffer_mutex};
+    if (loop_complete) {
+        shown = (shown + 1) % num_frames;
+        return {FrameStatus::ready, loop.at(shown)};
+    }
+    if (ready.empty()) {
+        return {failed ? FrameStatus::ended : FrameStatus::pending, nullptr};
+    }
+    auto [index, frame] = std::move(ready.front());
+    ready.pop_front();
+    shown = index;
+    buffer_cond.notify_one();
+    return {FrameStatus::ready, std::move(frame)};
+}
+
+void FrameBuffer::decode(const std::stop_token &stoken)
+{
+    // a few frames ahead are enough to absorb slow ones
+    const size_t capacity = 4;
+    int index = 1 % num_frames;
+    while (!stoken.stop_requested()) {
+        {
+            std::unique_lock lock{buffer_mutex};
+            if (!buffer_cond.wait(lock, stoken, [this] { return ready.size() < capacity; })) {
+                return;
+            }
+        }
+
+        std::shared_ptr<const Frame> frame;
+        try {
+            frame = decoder(index);
+        } catch (const std::exception &) {
+            logger->warn("Could not decode animation frame {}", index);
+            const std::scoped_lock lock{buffer_mutex};
+            failed = true;
+            buffer_cond.notify_all();
+            return;
+        }
+
+        const std::scoped_lock lock{buffer_mutex};
+        if (keep_loop) {
+            loop_bytes += frame->size;
+            if (loop_bytes > loop_budget) {
+                logger->debug("Animation is too large to keep in memory");
+                keep_loop = false;
+                loop.clear();
+                loop.shrink_to_fit();
+            } else {
+                loop.push_back(frame);
+                if (static_cast<int>(loop.size()) == num_frames) {
+                    logger->debug("Keeping the whole animation in memory");
+                    loop_complete = true;
+                    ready.clear();
+                    return;
+                }
+            }
+        }
+        ready.emplace_back(index, std::move(frame));
+        index = (index + 1) % num_frames;
+    }
+}
@@ -0,0 +1,83 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef IMAGE_FRAME_BUFFER_H
+#define IMAGE_FRAME_BUFFER_H
+
+#include "image.hpp"
+#include "util/ptr.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <glib.h>
+#include <spdlog/fwd.h>
+
+// pixels of an animation frame, already resized and converted
+struct Frame {
+    c_unique_ptr<unsigned char, g_free> data;
+    size_t size = 0;
+    int index = 0;
+};
+
+// bounded ring of processed animation frames, filled ahead by a background
+// decoder. when the whole processed loop fits in the budget it is kept and
+// the decoder stops once it went through it
+class FrameBuffer
+{
+  public:
+    using decoder_t = std::function<std::shared_ptr<const Frame>(int index)>;
+
+    FrameBuffer(int num_frames, std::shared_ptr<const Frame> first, decoder_t decoder, size_t loop_budget);
+    ~FrameBuffer();
+
+    FrameBuffer(const FrameBuffer &) = delete;
+    auto operator=(const FrameBuffer &) -> FrameBuffer & = delete;
+
+    // the frame after the last one returned, only set when ready
+    [[nodiscard]] auto next() -> std::pair<FrameStatus, std::shared_ptr<const Frame>>;
+
+  private:
+    int num_frames;
+    decoder_t decoder;
+    size_t loop_budget;
+    size_t loop_bytes = 0;
+
+    std::deque<std::pair<int, std::shared_ptr<const Frame>>> ready;
+    std::vector<std::shared_ptr<const Frame>> loop;
+    bool keep_loop = false;
+    bool loop_complete = false;
+    // the decoder stopped early, no more frames will come
+    bool failed = false;
+    int shown = 0;
+
+    std::mutex buffer_mutex;
+    std::condition_variable_any buffer_cond;
+    std::shared_ptr<spdlog::logger> logger;
+    std::jthread decode_thread;
+
+    void decode(const std::stop_token &stoken);
+};
+
+#endif
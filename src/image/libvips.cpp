@@ -15,13 +15,14 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "libvips.hpp"
+#include "cacheindex.hpp"
 #include "dimensions.hpp"
 #include "flags.hpp"
 #include "terminal.hpp"
 #include "util.hpp"
+#include "util/pixel.hpp"
 
 #include <algorithm>
-#include <unordered_set>
 
 #ifdef ENABLE_OPENCV
 #  include <opencv2/videoio.hpp>
@@ -30,8 +31,10 @@
 using vips::VError;
 using vips::VImage;
 
-LibvipsImage::LibvipsImage(std::shared_ptr<Dimensions> new_dims, const std::string &filename, bool in_cache)
+LibvipsImage::LibvipsImage(std::shared_ptr<Dimensions> new_dims, const std::string &filename,
+                           const std::string &source, bool in_cache)
     : path(filename),
+      source(source),
       dims(std::move(new_dims)),
       max_width(dims->max_wpixels()),
       max_height(dims->max_hpixels()),
@@ -45,21 +48,62 @@ LibvipsImage::LibvipsImage(std::shared_ptr<Dimensions> new_dims, const std::stri
     try {
         // animated images should have both n-pages and delay
         npages = image.get_int("n-pages");
-        std::ignore = image.get_array_int("delay");
-        is_anim = true;
-        logger->info("file is an animated image");
-        auto *opts = VImage::option()->set("n", -1);
-        backup = VImage::new_from_file(filename.c_str(), opts).colourspace(VIPS_INTERPRETATION_sRGB);
-        orig_height = backup.height() / npages;
-        image = backup.crop(0, 0, backup.width(), orig_height);
+        delays = image.get_array_int("delay");
+        is_anim = npages > 1;
+        if (is_anim) {
+            read_frame_timing();
+        }
     } catch (const VError &err) {
         logger->debug("Failed to process image animation");
     }
 
-    if (!is_anim) {
+    if (is_anim) {
+        logger->info("file is an animated image");
+        open_pages();
+        orig_height = backup.height() / npages;
+        image = backup.crop(0, 0, backup.width(), orig_height);
+        next_page = 1;
+    } else {
         image = image.autorot();
+        shrink_on_load();
     }
     process_image();
+
+    if (is_anim) {
+        const size_t bytes_per_mib = 1024 * 1024;
+        const auto loop_budget = static_cast<size_t>(std::max(flags->anim_cache_size, 0)) * bytes_per_mib;
+        current_frame = std::make_shared<const Frame>(Frame{.data = std::move(_data), .size = _size, .index = 0});
+        frames = std::make_unique<FrameBuffer>(
+            npages, current_frame, [this](int index) { return decode_frame(index); }, loop_budget);
+    }
+}
+
+// pages are read in order, the loader only keeps around the rows it needs
+auto LibvipsImage::open_pages() -> void
+{
+    auto *opts = VImage::option()->set("n", -1)->set("access", VIPS_ACCESS_SEQUENTIAL);
+    backup = VImage::new_from_file(path.c_str(), opts).colourspace(VIPS_INTERPRETATION_sRGB);
+}
+
+// runs on the frame buffer thread, image and the sizes are only read
+auto LibvipsImage::decode_frame(int index) -> std::shared_ptr<const Frame>
+{
+    if (index < next_page) {
+        open_pages();
+    }
+    next_page = index + 1;
+
+    auto frame = backup.crop(0, index * orig_height, backup.width(), orig_height);
+    if (frame.width() != width() || frame.height() != height()) {
+        auto *opts = VImage::option()->set("height", height())->set("size", VIPS_SIZE_FORCE);
+        frame = frame.thumbnail_image(width(), opts);
+    }
+#ifdef ENABLE_OPENGL
+    if (flags->use_opengl) {
+        frame = frame.flipver();
+    }
+#endif
+    return std::make_shared<const Frame>(Frame{.data = convert_pixels(frame), .size = _size, .index = index});
 }
 
 auto LibvipsImage::dimensions() const -> const Dimensions &
@@ -89,12 +133,15 @@ auto LibvipsImage::size() const -> size_t
 
 auto LibvipsImage::data() const -> const unsigned char *
 {
+    if (current_frame) {
+        return current_frame->data.get();
+    }
     return _data.get();
 }
 
 auto LibvipsImage::channels() const -> int
 {
-    return image.bands();
+    return _channels;
 }
 
 auto LibvipsImage::is_animated() const -> bool
@@ -102,40 +149,73 @@ auto LibvipsImage::is_animated() const -> bool
     return is_anim;
 }
 
-auto LibvipsImage::next_frame() -> void
+auto LibvipsImage::next_frame() -> FrameStatus
 {
-    if (!is_anim) {
-        return;
+    if (!frames) {
+        return FrameStatus::ended;
     }
-    top += orig_height;
-    if (top == backup.height()) {
-        top = 0;
+    auto [status, frame] = frames->next();
+    if (status == FrameStatus::ready) {
+        current_frame = std::move(frame);
     }
-    image = backup.crop(0, top, backup.width(), orig_height);
-    process_image();
+    return status;
+}
+
+auto LibvipsImage::frame_delays() const -> const std::vector<int> &
+{
+    return delays;
+}
+
+auto LibvipsImage::loop_count() const -> int
+{
+    return loops;
+}
+
+auto LibvipsImage::frame_index() const -> int
+{
+    return current_frame ? current_frame->index : 0;
 }
 
-auto LibvipsImage::frame_delay() const -> int
+// fills in the delays the file doesn't specify, once, so that
+// nothing has to look at the file again while playing
+auto LibvipsImage::read_frame_timing() -> void
 {
-    if (!is_anim) {
-        return -1;
+    if (image.get_typeof("loop") != 0) {
+        loops = image.get_int("loop");
     }
-    try {
-        const auto delays = backup.get_array_int("delay");
-        const int ms_per_sec = 1000;
-        if (delays.at(0) == 0) {
+    delays.resize(npages, 0);
+    if (std::ranges::find(delays, 0) == delays.end()) {
+        return;
+    }
+
+    const int ms_per_sec = 1000;
+    int fallback = static_cast<int>((1.0 / npages) * ms_per_sec);
 #ifdef ENABLE_OPENCV
-            const cv::VideoCapture video(path);
-            if (video.isOpened()) {
-                return static_cast<int>((1.0 / video.get(cv::CAP_PROP_FPS)) * ms_per_sec);
-            }
+    const cv::VideoCapture video(path);
+    if (video.isOpened() && video.get(cv::CAP_PROP_FPS) > 0) {
+        fallback = static_cast<int>((1.0 / video.get(cv::CAP_PROP_FPS)) * ms_per_sec);
+    }
 #endif
-            return static_cast<int>((1.0 / npages) * ms_per_sec);
-        }
-        return delays.at(0);
-    } catch (const VError &err) {
-        return -1;
+    std::ranges::replace(delays, 0, fallback);
+}
+
+// let the loader decode at a reduced size, e.g. jpeg shrink-on-load,
+// instead of decoding the full image and resizing it afterwards
+auto LibvipsImage::shrink_on_load() -> void
+{
+    if (in_cache) {
+        return;
     }
+    const auto [new_width, new_height] = get_new_sizes(max_width, max_height, dims->scaler, flags->scale_factor);
+    if (new_width <= 0 || new_height <= 0 || new_width >= width() || new_height >= height()) {
+        return;
+    }
+
+    logger->debug("Shrinking image on load");
+    // thumbnail applies the exif orientation, sizes are already in that orientation
+    auto *opts = VImage::option()->set("height", new_height)->set("size", VIPS_SIZE_FORCE);
+    image = VImage::thumbnail(path.c_str(), new_width, opts).colourspace(VIPS_INTERPRETATION_sRGB);
+    shrunk_on_load = true;
 }
 
 auto LibvipsImage::resize_image() -> void
@@ -143,34 +223,41 @@ auto LibvipsImage::resize_image() -> void
     if (in_cache) {
         return;
     }
-    const auto [new_width, new_height] = get_new_sizes(max_width, max_height, dims->scaler, flags->scale_factor);
-    if (new_width <= 0 && new_height <= 0) {
-        // ensure width and height are pair
-        if (flags->needs_scaling) {
-            const auto curw = width();
-            const auto curh = height();
-            if ((curw % 2) != 0 || (curh % 2) != 0) {
-                auto *opts = VImage::option()
-                                 ->set("height", util::round_up(curh, flags->scale_factor))
-                                 ->set("size", VIPS_SIZE_FORCE);
-                image = image.thumbnail_image(util::round_up(curw, flags->scale_factor), opts);
+    if (!shrunk_on_load) {
+        const auto [new_width, new_height] = get_new_sizes(max_width, max_height, dims->scaler, flags->scale_factor);
+        if (new_width <= 0 && new_height <= 0) {
+            // ensure width and height are pair
+            if (flags->needs_scaling) {
+                const auto curw = width();
+                const auto curh = height();
+                if ((curw % 2) != 0 || (curh % 2) != 0) {
+                    auto *opts = VImage::option()
+                                     ->set("height", util::round_up(curh, flags->scale_factor))
+                                     ->set("size", VIPS_SIZE_FORCE);
+                    image = image.thumbnail_image(util::round_up(curw, flags->scale_factor), opts);
+                }
             }
+            return;
         }
-        return;
-    }
 
-    logger->debug("Resizing image");
+        logger->debug("Resizing image");
 
-    auto *opts = VImage::option()->set("height", new_height)->set("size", VIPS_SIZE_FORCE);
-    image = image.thumbnail_image(new_width, opts);
+        auto *opts = VImage::option()->set("height", new_height)->set("size", VIPS_SIZE_FORCE);
+        image = image.thumbnail_image(new_width, opts);
+    }
 
     if (is_anim || flags->no_cache) {
         return;
     }
 
-    const auto save_location = util::get_cache_file_save_location(path);
+    const auto cache_index = CacheIndex::instance();
+    const auto save_location = cache_index->save_location(source, width(), height());
+    if (!save_location.has_value()) {
+        return;
+    }
     try {
-        image.write_to_file(save_location.c_str());
+        image.write_to_file(save_location->c_str());
+        cache_index->insert(source, save_location.value(), width(), height());
         logger->debug("Saved resized image");
     } catch (const VError &err) {
         logger->debug("Could not save resized image");
@@ -187,30 +274,42 @@ auto LibvipsImage::process_image() -> void
         dims->y -= std::floor(img_height / 2);
     }
 
-    const std::unordered_set<std::string_view> bgra_trifecta = {"x11", "chafa", "wayland"};
-
 #ifdef ENABLE_OPENGL
     if (flags->use_opengl) {
         image = image.flipver();
     }
 #endif
 
-    if (bgra_trifecta.contains(flags->output)) {
-        // alpha channel required
-        if (!image.has_alpha()) {
-            const int alpha_value = 255;
-            image = image.bandjoin(alpha_value);
-        }
-        // convert from RGB to BGR
-        auto bands = image.bandsplit();
-        std::swap(bands[0], bands[2]);
-        image = VImage::bandjoin(bands);
-    } else if (flags->output == "sixel") {
-        // sixel expects RGB888
-        if (image.has_alpha()) {
-            image = image.flatten();
-        }
+    pixel_target = util::pixel::target_for(flags->output, image.has_alpha());
+    _channels = pixel_target.channels;
+    _size = static_cast<size_t>(width()) * height() * _channels;
+    _data = convert_pixels(image);
+}
+
+// depth reduction, premultiplication and channel order in one pass
+auto LibvipsImage::convert_pixels(vips::VImage img) const -> c_unique_ptr<unsigned char, g_free>
+{
+    if (img.format() != VIPS_FORMAT_UCHAR && img.format() != VIPS_FORMAT_USHORT) {
+        img = img.cast(VIPS_FORMAT_UCHAR);
+    }
+    const int depth = img.format() == VIPS_FORMAT_USHORT ? 16 : 8;
+    const util::pixel::Format format{.channels = img.bands(), .depth = depth, .order = util::pixel::Order::rgb};
+    const auto count = static_cast<size_t>(img.width()) * img.height();
+
+    size_t pixels_size = 0;
+    c_unique_ptr<unsigned char, g_free> pixels{static_cast<unsigned char *>(img.write_to_memory(&pixels_size))};
+    const bool same_layout = format.channels == pixel_target.channels && format.depth == 8 &&
+                             format.order == pixel_target.order && !pixel_target.premultiply;
+    if (same_layout) {
+        return pixels;
+    }
+    // both have four 8-bit channels, convert in place
+    if (format.channels == 4 && format.depth == 8 && pixel_target.channels == 4) {
+        util::pixel::convert(pixels.get(), format, pixels.get(), pixel_target, count);
+        return pixels;
     }
-    _size = VIPS_IMAGE_SIZEOF_IMAGE(image.get_image());
-    _data.reset(static_cast<unsigned char *>(image.write_to_memory(&_size)));
+    c_unique_ptr<unsigned char, g_free> converted{
+        static_cast<unsigned char *>(g_malloc(count * pixel_target.channels))};
+    util::pixel::convert(pixels.get(), format, converted.get(), pixel_target, count);
+    return converted;
 }
@@ -17,7 +17,9 @@
 #ifndef LIBVIPS_IMAGE_H
 #define LIBVIPS_IMAGE_H
 
+#include "framebuffer.hpp"
 #include "image.hpp"
+#include "util/pixel.hpp"
 #include "util/ptr.hpp"
 
 #include <filesystem>
@@ -28,7 +30,8 @@
 class LibvipsImage : public Image
 {
   public:
-    LibvipsImage(std::shared_ptr<Dimensions> new_dims, const std::string &filename, bool in_cache);
+    LibvipsImage(std::shared_ptr<Dimensions> new_dims, const std::string &filename, const std::string &source,
+                 bool in_cache);
 
     [[nodiscard]] auto dimensions() const -> const Dimensions & override;
     [[nodiscard]] auto width() const -> int override;
@@ -37,8 +40,10 @@ class LibvipsImage : public Image
     [[nodiscard]] auto data() const -> const unsigned char * override;
     [[nodiscard]] auto channels() const -> int override;
 
-    void next_frame() override;
-    [[nodiscard]] auto frame_delay() const -> int override;
+    auto next_frame() -> FrameStatus override;
+    [[nodiscard]] auto frame_delays() const -> const std::vector<int> & override;
+    [[nodiscard]] auto loop_count() const -> int override;
+    [[nodiscard]] auto frame_index() const -> int override;
     [[nodiscard]] auto is_animated() const -> bool override;
     [[nodiscard]] auto filename() const -> std::string override;
 
@@ -48,6 +53,8 @@ class LibvipsImage : public Image
 
     c_unique_ptr<unsigned char, g_free> _data;
     std::filesystem::path path;
+    // original file, path may point to a cached copy of it
+    std::filesystem::path source;
     std::shared_ptr<Dimensions> dims;
 
     std::shared_ptr<Flags> flags;
@@ -57,15 +64,30 @@ class LibvipsImage : public Image
     uint32_t max_height;
     size_t _size = 0;
 
+    util::pixel::Target pixel_target;
+    int _channels = 0;
+
     // for animated pictures
-    int top = 0;
-    int orig_height;
+    std::vector<int> delays;
+    int loops = 0;
+    int orig_height = 0;
     int npages = 0;
+    int next_page = 0;
     bool is_anim = false;
     bool in_cache;
+    bool shrunk_on_load = false;
+
+    // declared last, its decoder thread uses the members above
+    std::shared_ptr<const Frame> current_frame;
+    std::unique_ptr<FrameBuffer> frames;
 
     void process_image();
     void resize_image();
+    void shrink_on_load();
+    void open_pages();
+    void read_frame_timing();
+    [[nodiscard]] auto decode_frame(int index) -> std::shared_ptr<const Frame>;
+    [[nodiscard]] auto convert_pixels(vips::VImage img) const -> c_unique_ptr<unsigned char, g_free>;
 };
 
 #endif
@@ -0,0 +1,93 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "memcache.hpp"
+#include "dimensions.hpp"
+#include "flags.hpp"
+#include "image.hpp"
+
+#include <algorithm>
+
+#include <fmt/format.h>
+
+namespace fs = std::filesystem;
+
+ImageMemCache::ImageMemCache()
+{
+    const auto flags = Flags::instance();
+    const uint64_t bytes_per_mib = 1024 * 1024;
+    max_bytes = static_cast<uint64_t>(std::max(flags->mem_cache_size, 0)) * bytes_per_mib;
+}
+
+auto ImageMemCache::make_key(const fs::path &path, const Dimensions &dimensions) -> std::optional<std::string>
+{
+    std::error_code err;
+    const auto mtime = fs::last_write_time(path, err);
+    if (err) {
+        return {};
+    }
+    const auto flags = Flags::instance();
+    return fmt::format("{}:{}:{}x{}:{}:{}", path.string(), mtime.time_since_epoch().count(), dimensions.max_wpixels(),
+                       dimensions.max_hpixels(), dimensions.scaler, flags->output);
+}
+
+auto ImageMemCache::get(const std::string &key) -> std::shared_ptr<const MemCacheEntry>
+{
+    const std::scoped_lock lock{cache_mutex};
+    const auto found = index.find(key);
+    if (found == index.end()) {
+        return nullptr;
+    }
+    // move to the front, most recently used
+    entries.splice(entries.begin(), entries, found->second);
+    return found->second->second;
+}
+
+void ImageMemCache::put(const std::string &key, const Image &image)
+{
+    if (image.size() > max_bytes) {
+        return;
+    }
+
+    auto entry = std::make_shared<MemCacheEntry>();
+    entry->data.assign(image.data(), image.data() + image.size());
+    entry->filename = image.filename();
+    entry->width = image.width();
+    entry->height = image.height();
+    entry->channels = image.channels();
+
+    const std::scoped_lock lock{cache_mutex};
+    const auto found = index.find(key);
+    if (found != index.end()) {
+        cur_bytes -= found->second->second->data.size();
+        entries.erase(found->second);
+        index.erase(found);
+    }
+    cur_bytes += entry->data.size();
+    entries.emplace_front(key, std::move(entry));
+    index.insert_or_assign(key, entries.begin());
+    evict();
+}
+
+void ImageMemCache::evict()
+{
+    while (cur_bytes > max_bytes && !entries.empty()) {
+        const auto &[key, entry] = entries.back();
+        cur_bytes -= entry->data.size();
+        index.erase(key);
+        entries.pop_back();
+    }
+}
@@ -0,0 +1,79 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#ifndef IMAGE_MEMCACHE_H
+#define IMAGE_MEMCACHE_H
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Dimensions;
+class Image;
+
+// pixels of an already processed image, ready to be handed to a canvas
+struct MemCacheEntry {
+    std::vector<unsigned char> data;
+    std::string filename;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+};
+
+// singleton, byte budgeted LRU of processed images
+class ImageMemCache
+{
+  public:
+    static auto instance() -> std::shared_ptr<ImageMemCache>
+    {
+        static std::shared_ptr<ImageMemCache> instance{new ImageMemCache};
+        return instance;
+    }
+
+    ImageMemCache(const ImageMemCache &) = delete;
+    ImageMemCache(ImageMemCache &) = delete;
+    auto operator=(const ImageMemCache &) -> ImageMemCache & = delete;
+    auto operator=(ImageMemCache &) -> ImageMemCache & = delete;
+
+    static auto make_key(const std::filesystem::path &path, const Dimensions &dimensions)
+        -> std::optional<std::string>;
+
+    auto get(const std::string &key) -> std::shared_ptr<const MemCacheEntry>;
+    void put(const std::string &key, const Image &image);
+
+  private:
+    ImageMemCache();
+
+    using lru_list = std::list<std::pair<std::string, std::shared_ptr<const MemCacheEntry>>>;
+
+    lru_list entries;
+    std::unordered_map<std::string, lru_list::iterator> index;
+    std::mutex cache_mutex;
+
+    uint64_t max_bytes = 0;
+    uint64_t cur_bytes = 0;
+
+    void evict();
+};
+
+#endif
@@ -15,17 +15,20 @@
 // along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "opencv.hpp"
+#include "cacheindex.hpp"
 #include "dimensions.hpp"
 #include "flags.hpp"
 #include "terminal.hpp"
 #include "util.hpp"
+#include "util/pixel.hpp"
 
-#include <string_view>
-#include <unordered_set>
+#include <algorithm>
+#include <cctype>
 
 #include <opencv2/core/ocl.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
+#include <vips/vips8>
 
 enum {
     EXIF_ORIENTATION_2 = 2,
@@ -37,22 +40,24 @@ enum {
     EXIF_ORIENTATION_8,
 };
 
-OpencvImage::OpencvImage(std::shared_ptr<Dimensions> new_dims, const std::string &filename, bool in_cache)
+OpencvImage::OpencvImage(std::shared_ptr<Dimensions> new_dims, const std::string &filename,
+                         const std::string &source, bool in_cache)
     : path(filename),
+      source(source),
       dims(std::move(new_dims)),
       max_width(dims->max_wpixels()),
       max_height(dims->max_hpixels()),
       in_cache(in_cache)
 {
     logger = spdlog::get("opencv");
-    image = cv::imread(filename, cv::IMREAD_UNCHANGED);
+    flags = Flags::instance();
+    image = cv::imread(filename, get_read_flags());
 
     if (image.empty()) {
         logger->warn("unable to read image");
         throw std::runtime_error("");
     }
     logger->info("loading file {}", filename);
-    flags = Flags::instance();
 
     rotate_image();
     process_image();
@@ -100,6 +105,53 @@ void OpencvImage::wayland_processing()
     }
 }
 
+// jpeg files can be decoded directly at 1/2, 1/4 or 1/8 of their size
+auto OpencvImage::get_read_flags() const -> int
+{
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char chr) { return std::tolower(chr); });
+    if (in_cache || (extension != ".jpg" && extension != ".jpeg")) {
+        return cv::IMREAD_UNCHANGED;
+    }
+
+    int img_width = 0;
+    int img_height = 0;
+    try {
+        const auto header = vips::VImage::new_from_file(path.c_str());
+        img_width = header.width();
+        img_height = header.height();
+        if (header.get_typeof("orientation") != 0 && header.get_int("orientation") >= EXIF_ORIENTATION_5) {
+            std::swap(img_width, img_height);
+        }
+    } catch (const vips::VError &) {
+        return cv::IMREAD_UNCHANGED;
+    }
+
+    const auto [new_width, new_height] =
+        calculate_sizes(img_width, img_height, max_width, max_height, dims->scaler, flags->scale_factor);
+    if (new_width <= 0 || new_height <= 0) {
+        return cv::IMREAD_UNCHANGED;
+    }
+    const double factor = std::min(static_cast<double>(img_width) / new_width,
+                                   static_cast<double>(img_height) / new_height);
+
+    // orientation is handled by rotate_image
+    const int reduce_8 = 8;
+    const int reduce_4 = 4;
+    const int reduce_2 = 2;
+    if (factor >= reduce_8) {
+        return cv::IMREAD_REDUCED_COLOR_8 | cv::IMREAD_IGNORE_ORIENTATION;
+    }
+    if (factor >= reduce_4) {
+        return cv::IMREAD_REDUCED_COLOR_4 | cv::IMREAD_IGNORE_ORIENTATION;
+    }
+    if (factor >= reduce_2) {
+        return cv::IMREAD_REDUCED_COLOR_2 | cv::IMREAD_IGNORE_ORIENTATION;
+    }
+    return cv::IMREAD_UNCHANGED;
+}
+
 void OpencvImage::rotate_image()
 {
     const auto rotation = util::read_exif_rotation(path);
@@ -181,15 +233,46 @@ void OpencvImage::resize_image_helper(cv::InputOutputArray &mat, int new_width,
         return;
     }
 
-    const auto save_location = util::get_cache_file_save_location(path);
+    const auto cache_index = CacheIndex::instance();
+    const auto save_location = cache_index->save_location(source, new_width, new_height);
+    if (!save_location.has_value()) {
+        return;
+    }
     try {
-        cv::imwrite(save_location, mat);
-        logger->debug("Saved resized image");
+        if (cv::imwrite(save_location.value(), mat)) {
+            cache_index->insert(source, save_location.value(), new_width, new_height);
+            logger->debug("Saved resized image");
+        }
     } catch (const cv::Exception &ex) {
         logger->error("Could not save image");
     }
 }
 
+// depth reduction, premultiplication and channel order in one pass
+void OpencvImage::convert_pixels()
+{
+    if (image.depth() != CV_8U && image.depth() != CV_16U) {
+        image.convertTo(image, CV_8U);
+    }
+    if (!image.isContinuous()) {
+        image = image.clone();
+    }
+    const int channels = image.channels();
+    const int depth = image.depth() == CV_16U ? 16 : 8;
+    const util::pixel::Format format{.channels = channels, .depth = depth, .order = util::pixel::Order::bgr};
+    const auto target = util::pixel::target_for(flags->output, channels == 2 || channels == 4);
+
+    // both have four 8-bit channels, convert in place
+    cv::Mat converted;
+    if (format.channels == 4 && format.depth == 8 && target.channels == 4) {
+        converted = image;
+    } else {
+        converted.create(image.rows, image.cols, CV_8UC(target.channels));
+    }
+    util::pixel::convert(image.data, format, converted.data, target, image.total());
+    image = converted;
+}
+
 void OpencvImage::process_image()
 {
     resize_image();
@@ -200,50 +283,12 @@ void OpencvImage::process_image()
         dims->y -= std::floor(img_height / 2);
     }
 
-    const std::unordered_set<std::string_view> bgra_trifecta = {"x11", "chafa", "wayland"};
-
-    if (image.depth() == CV_16U) {
-        const float alpha = 0.00390625; // 1 / 256
-        image.convertTo(image, CV_8U, alpha);
-    }
-
-    if (image.channels() == 4) {
-        // premultiply alpha
-        image.forEach<cv::Vec4b>([](cv::Vec4b &pix, const int *) {
-            const uint8_t alpha = pix[3];
-            const uint8_t div = 255;
-            pix[0] = (pix[0] * alpha) / div;
-            pix[1] = (pix[1] * alpha) / div;
-            pix[2] = (pix[2] * alpha) / div;
-        });
-    }
-
 #ifdef ENABLE_OPENGL
     if (flags->use_opengl) {
         cv::flip(image, image, 0);
     }
 #endif
 
-    if (image.channels() == 1) {
-        cv::cvtColor(image, image, cv::COLOR_GRAY2BGRA);
-    }
-
-    if (bgra_trifecta.contains(flags->output)) {
-        if (image.channels() == 3) {
-            cv::cvtColor(image, image, cv::COLOR_BGR2BGRA);
-        }
-    } else if (flags->output == "kitty") {
-        if (image.channels() == 4) {
-            cv::cvtColor(image, image, cv::COLOR_BGRA2RGBA);
-        } else {
-            cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-        }
-    } else if (flags->output == "sixel") {
-        if (image.channels() == 4) {
-            cv::cvtColor(image, image, cv::COLOR_BGRA2RGB);
-        } else {
-            cv::cvtColor(image, image, cv::COLOR_BGR2RGB);
-        }
-    }
+    convert_pixels();
     _size = image.total() * image.elemSize();
 }
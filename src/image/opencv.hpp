@@ -29,7 +29,8 @@ namespace fs = std::filesystem;
 class OpencvImage : public Image
 {
   public:
-    OpencvImage(std::shared_ptr<Dimensions> new_dims, const std::string &filename, bool in_cache);
+    OpencvImage(std::shared_ptr<Dimensions> new_dims, const std::string &filename, const std::string &source,
+                bool in_cache);
     ~OpencvImage() override = default;
 
     [[nodiscard]] auto dimensions() const -> const Dimensions & override;
@@ -46,6 +47,8 @@ class OpencvImage : public Image
     cv::UMat uimage;
 
     fs::path path;
+    // original file, path may point to a cached copy of it
+    fs::path source;
     std::shared_ptr<Dimensions> dims;
 
     uint64_t _size = 0;
@@ -58,9 +61,11 @@ class OpencvImage : public Image
     std::shared_ptr<Flags> flags;
 
     void process_image();
+    void convert_pixels();
     void resize_image();
     void resize_image_helper(cv::InputOutputArray &mat, int new_width, int new_height);
 
+    [[nodiscard]] auto get_read_flags() const -> int;
     void rotate_image();
     void wayland_processing();
 };
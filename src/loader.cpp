@@ -0,0 +1,174 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "loader.hpp"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+ImageLoader::ImageLoader(const Terminal *terminal, callback_t on_load)
+    : terminal(terminal),
+      on_load(std::move(on_load)),
+      logger(spdlog::get("main"))
+{
+    // decoders are already multithreaded, a couple of workers is enough
+    // to keep a slow file from blocking the ones requested after it
+    const int max_workers = 4;
+    const int num_workers = std::clamp(static_cast<int>(std::thread::hardware_concurrency() / 2), 1, max_workers);
+    for (int i = 0; i < num_workers; ++i) {
+        workers.emplace_back([this](const std::stop_token &stoken) { work(stoken); });
+    }
+}
+
+ImageLoader::~ImageLoader()
+{
+    for (auto &worker : workers) {
+        worker.request_stop();
+    }
+    workers.clear();
+}
+
+void ImageLoader::add(const std::string &identifier, const nlohmann::json &command)
+{
+    {
+        const std::scoped_lock lock{queue_mutex};
+        const auto generation = ++next_generation;
+        generations.insert_or_assign(identifier, generation);
+
+        // requests for the same identifier that didn't start yet are superseded
+        std::erase_if(requests, [&identifier](const Request &req) { return req.identifier == identifier; });
+        requests.push_back({.identifier = identifier, .command = command, .generation = generation});
+    }
+    queue_cond.notify_one();
+}
+
+void ImageLoader::cancel(const std::string &identifier)
+{
+    // wait for a running delivery, so nothing is drawn after this returns
+    const std::scoped_lock deliver_lock{deliver_mutex};
+    const std::scoped_lock lock{queue_mutex};
+    generations.erase(identifier);
+    std::erase_if(requests, [&identifier](const Request &req) { return req.identifier == identifier; });
+}
+
+void ImageLoader::prefetch(const nlohmann::json &command)
+{
+    if (!command.contains("paths")) {
+        logger->error("Prefetch command has no paths");
+        return;
+    }
+    const auto &paths = command.at("paths");
+    if (!paths.is_array()) {
+        logger->error("Prefetch paths received are not valid");
+        return;
+    }
+    {
+        const std::scoped_lock lock{queue_mutex};
+        // only the latest neighbours are worth decoding
+        prefetches.clear();
+        for (const auto &path : paths) {
+            if (!path.is_string()) {
+                continue;
+            }
+            auto request = command;
+            request.erase("paths");
+            request["action"] = "add";
+            request["path"] = path;
+            if (!request.contains("x")) {
+                request["x"] = 0;
+            }
+            if (!request.contains("y")) {
+                request["y"] = 0;
+            }
+            prefetches.push_back(std::move(request));
+        }
+    }
+    queue_cond.notify_one();
+}
+
+void ImageLoader::work(const std::stop_token &stoken)
+{
+    while (!stoken.stop_requested()) {
+        Request request;
+        nlohmann::json prefetch_cmd;
+        {
+            std::unique_lock lock{queue_mutex};
+            const bool has_work = queue_cond.wait(lock, stoken, [this] {
+                return !requests.empty() || (!prefetches.empty() && running_prefetches == 0);
+            });
+            if (!has_work) {
+                return;
+            }
+            if (requests.empty()) {
+                prefetch_cmd = std::move(prefetches.front());
+                prefetches.pop_front();
+                ++running_prefetches;
+            } else {
+                request = std::move(requests.front());
+                requests.pop_front();
+            }
+        }
+
+        if (!prefetch_cmd.is_null()) {
+            run_prefetch(prefetch_cmd);
+            continue;
+        }
+
+        std::unique_ptr<Image> image;
+        try {
+            image = Image::load(request.command, terminal);
+        } catch (const std::exception &err) {
+            logger->error("Could not load image: {}", err.what());
+            continue;
+        }
+        if (!image) {
+            logger->error("Unable to load image file");
+            continue;
+        }
+        deliver(request, std::move(image));
+    }
+}
+
+void ImageLoader::run_prefetch(const nlohmann::json &command)
+{
+    logger->debug("Prefetching {}", command.at("path").get<std::string>());
+    try {
+        // loading is enough to fill the memory and disk caches
+        std::ignore = Image::load(command, terminal);
+    } catch (const std::exception &) {
+        logger->debug("Could not prefetch image");
+    }
+    {
+        const std::scoped_lock lock{queue_mutex};
+        --running_prefetches;
+    }
+    queue_cond.notify_one();
+}
+
+void ImageLoader::deliver(const Request &request, std::unique_ptr<Image> image)
+{
+    const std::scoped_lock deliver_lock{deliver_mutex};
+    {
+        const std::scoped_lock lock{queue_mutex};
+        const auto found = generations.find(request.identifier);
+        if (found == generations.end() || found->second != request.generation) {
+            logger->debug("Discarding superseded image for identifier {}", request.identifier);
+            return;
+        }
+    }
+    on_load(request.identifier, std::move(image));
+}
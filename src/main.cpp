@@ -81,9 +81,15 @@ auto main(int argc, char *argv[]) -> int
     layer_command->add_option("--pid-file", flags->pid_file, "Output file where to write the daemon PID.");
     layer_command->add_flag("--no-stdin", flags->no_stdin, "Do not listen on stdin for commands.")->needs("--pid-file");
     layer_command->add_flag("--no-cache", flags->no_cache, "Disable caching of resized images.");
+    layer_command->add_option("--mem-cache-size", flags->mem_cache_size,
+                              "Size in MiB of the in-memory cache of processed images, 0 disables it.");
+    layer_command->add_option("--anim-cache-size", flags->anim_cache_size,
+                              "Largest animation in MiB kept fully processed in memory, 0 disables it.");
     layer_command->add_flag("--no-opencv", flags->no_opencv, "Do not use OpenCV, use Libvips instead.");
     layer_command->add_option("-o,--output", flags->output, "Image output method")
         ->check(CLI::IsMember({"x11", "wayland", "sixel", "kitty", "iterm2", "chafa"}));
+    layer_command->add_option("--sixel-quality", flags->sixel_quality, "Sixel palette quality, fast skips dithering.")
+        ->check(CLI::IsMember(Flags::sixel_qualities));
     layer_command->add_flag("--origin-center", flags->origin_center, "Location of the origin wrt the image");
     layer_command->add_option("-p,--parser", nullptr, "**UNUSED**, only present for backwards compatibility.");
     layer_command->add_option("-l,--loader", nullptr, "**UNUSED**, only present for backwards compatibility.");
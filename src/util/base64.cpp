@@ -0,0 +1,225 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "util.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#ifdef ENABLE_TURBOBASE64
+#  ifdef WITH_SYSTEM_TURBOBASE64
+#    include <turbobase64/turbob64.h>
+#  else
+#    include "turbob64.h"
+#  endif
+#elif (defined(__x86_64__) || defined(__i386__))
+#  define BASE64_X86 1
+#  include <immintrin.h>
+#elif defined(__aarch64__)
+#  define BASE64_NEON 1
+#  include <arm_neon.h>
+#endif
+
+namespace
+{
+
+constexpr std::array<char, 64> alphabet = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V',
+    'W', 'X', 'Y', 'Z', 'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r',
+    's', 't', 'u', 'v', 'w', 'x', 'y', 'z', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '+', '/'};
+
+// kernels encode whole blocks and return how many input bytes they consumed
+using kernel_t = size_t (*)(const unsigned char *input, size_t length, unsigned char *out);
+
+void encode_scalar(const unsigned char *input, size_t length, unsigned char *out)
+{
+    const uint32_t mask = 0x3f;
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3) {
+        const uint32_t triple = (static_cast<uint32_t>(input[i]) << 16) | (static_cast<uint32_t>(input[i + 1]) << 8) |
+                                static_cast<uint32_t>(input[i + 2]);
+        *out++ = alphabet[(triple >> 18) & mask];
+        *out++ = alphabet[(triple >> 12) & mask];
+        *out++ = alphabet[(triple >> 6) & mask];
+        *out++ = alphabet[triple & mask];
+    }
+    const size_t rest = length - i;
+    if (rest == 0) {
+        return;
+    }
+    uint32_t triple = static_cast<uint32_t>(input[i]) << 16;
+    if (rest == 2) {
+        triple |= static_cast<uint32_t>(input[i + 1]) << 8;
+    }
+    *out++ = alphabet[(triple >> 18) & mask];
+    *out++ = alphabet[(triple >> 12) & mask];
+    *out++ = rest == 2 ? alphabet[(triple >> 6) & mask] : '=';
+    *out = '=';
+}
+
+#ifdef BASE64_X86
+
+// both kernels split 12 bytes, loaded in the low 3 bytes of every 32-bit
+// lane, into 16 indices of 6 bits and add the offset of their range of the
+// alphabet. from "Faster Base64 Encoding and Decoding Using AVX2
+// Instructions" by Muła, Kurz and Lemire
+
+__attribute__((target("ssse3"))) auto encode_ssse3(const unsigned char *input, size_t length, unsigned char *out)
+    -> size_t
+{
+    const __m128i spread = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    // 0-25 pick 'A', 26-51 'a', 52-61 '0' and the last two '+' and '/'
+    const __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    const size_t in_step = 12;
+    const size_t out_step = 16;
+    size_t i = 0;
+    // a full vector is loaded, 4 bytes past the ones used
+    for (; i + out_step <= length; i += in_step, out += out_step) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+        in = _mm_shuffle_epi8(in, spread);
+        const __m128i high = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        const __m128i low = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        const __m128i indices = _mm_or_si128(high, low);
+
+        __m128i ranges = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        const __m128i letters = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        ranges = _mm_or_si128(ranges, _mm_and_si128(letters, _mm_set1_epi8(13)));
+        const __m128i res = _mm_add_epi8(_mm_shuffle_epi8(shift, ranges), indices);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out), res);
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) auto encode_avx2(const unsigned char *input, size_t length, unsigned char *out)
+    -> size_t
+{
+    const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4,
+                                            7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                           'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    const size_t in_step = 24;
+    const size_t out_step = 32;
+    const size_t lane_step = 12;
+    const size_t lane_size = 16;
+    size_t i = 0;
+    for (; i + lane_step + lane_size <= length; i += in_step, out += out_step) {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(input + i + lane_step));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(first), second, 1);
+        in = _mm256_shuffle_epi8(in, spread);
+        const __m256i high =
+            _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        const __m256i low =
+            _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(high, low);
+
+        __m256i ranges = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i letters = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        ranges = _mm256_or_si256(ranges, _mm256_and_si256(letters, _mm256_set1_epi8(13)));
+        const __m256i res = _mm256_add_epi8(_mm256_shuffle_epi8(shift, ranges), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), res);
+    }
+    return i;
+}
+
+auto select_kernel() -> kernel_t
+{
+    static const kernel_t kernel = []() -> kernel_t {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") != 0) {
+            return encode_avx2;
+        }
+        if (__builtin_cpu_supports("ssse3") != 0) {
+            return encode_ssse3;
+        }
+        return nullptr;
+    }();
+    return kernel;
+}
+
+#elif defined(BASE64_NEON)
+
+auto encode_neon(const unsigned char *input, size_t length, unsigned char *out) -> size_t
+{
+    const size_t in_step = 48;
+    const size_t out_step = 64;
+    const uint8x16x4_t table = vld1q_u8_x4(reinterpret_cast<const uint8_t *>(alphabet.data()));
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+    size_t i = 0;
+    for (; i + in_step <= length; i += in_step, out += out_step) {
+        const uint8x16x3_t in = vld3q_u8(input + i);
+        uint8x16x4_t res;
+        res.val[0] = vshrq_n_u8(in.val[0], 2);
+        res.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask);
+        res.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask);
+        res.val[3] = vandq_u8(in.val[2], mask);
+        for (auto &val : res.val) {
+            val = vqtbl4q_u8(table, val);
+        }
+        vst4q_u8(out, res);
+    }
+    return i;
+}
+
+auto select_kernel() -> kernel_t
+{
+    return encode_neon;
+}
+
+#else
+
+auto select_kernel() -> kernel_t
+{
+    return nullptr;
+}
+
+#endif
+
+} // namespace
+
+auto util::base64_encode(const unsigned char *input, size_t length) -> std::string
+{
+    const auto encoded_size = base64_encoded_size(length);
+    // room for a terminator, turbo-base64 may write one
+    std::string res(encoded_size + 1, 0);
+    base64_encode_v2(input, length, reinterpret_cast<unsigned char *>(res.data()));
+    res.resize(encoded_size);
+    return res;
+}
+
+auto util::base64_encoded_size(size_t length) -> size_t
+{
+    return 4 * ((length + 2) / 3);
+}
+
+// writes exactly base64_encoded_size(length) bytes, padding included
+void util::base64_encode_v2(const unsigned char *input, size_t length, unsigned char *out)
+{
+#ifdef ENABLE_TURBOBASE64
+    tb64enc(input, length, out);
+#else
+    size_t done = 0;
+    const auto kernel = select_kernel();
+    if (kernel != nullptr) {
+        done = kernel(input, length, out);
+    }
+    encode_scalar(input + done, length - done, out + base64_encoded_size(done));
+#endif
+}
@@ -0,0 +1,337 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+#include "util/pixel.hpp"
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#  define PIXEL_X86 1
+#  include <immintrin.h>
+#elif defined(__ARM_NEON)
+#  define PIXEL_NEON 1
+#  include <arm_neon.h>
+#endif
+
+namespace util::pixel
+{
+
+namespace
+{
+
+using kernel_t = size_t (*)(const void *src, unsigned char *dst, size_t count, bool swap, bool premultiply);
+
+constexpr int wide_depth = 16;
+
+// x * a / 255 rounded, exact for every 8-bit x and a
+constexpr auto div255(uint32_t val) -> uint32_t
+{
+    val += 128;
+    return (val + (val >> 8)) >> 8;
+}
+
+void convert_scalar(const void *src, const Format &format, unsigned char *dst, const Target &target, size_t begin,
+                    size_t count)
+{
+    const auto *src8 = static_cast<const uint8_t *>(src);
+    const auto *src16 = static_cast<const uint16_t *>(src);
+    const bool wide = format.depth == wide_depth;
+    const bool swap = format.order != target.order;
+    const auto in_ch = static_cast<size_t>(format.channels);
+    const auto out_ch = static_cast<size_t>(target.channels);
+
+    for (size_t i = begin; i < count; ++i) {
+        std::array<uint32_t, 4> pix{0, 0, 0, 255};
+        for (size_t chan = 0; chan < in_ch; ++chan) {
+            const size_t idx = (i * in_ch) + chan;
+            pix[chan] = wide ? static_cast<uint32_t>(src16[idx] >> 8) : src8[idx];
+        }
+        if (in_ch <= 2) {
+            if (in_ch == 2) {
+                pix[3] = pix[1];
+            }
+            pix[1] = pix[0];
+            pix[2] = pix[0];
+        } else if (swap) {
+            std::swap(pix[0], pix[2]);
+        }
+        if (target.premultiply) {
+            for (size_t chan = 0; chan < 3; ++chan) {
+                pix[chan] = div255(pix[chan] * pix[3]);
+            }
+        }
+        for (size_t chan = 0; chan < out_ch; ++chan) {
+            dst[(i * out_ch) + chan] = static_cast<uint8_t>(pix[chan]);
+        }
+    }
+}
+
+#ifdef PIXEL_X86
+
+// premultiplies two pixels widened to 16 bits, the alpha lanes are multiplied by 255
+inline auto premultiply_sse2(__m128i pix) -> __m128i
+{
+    const __m128i alpha_lanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const __m128i round = _mm_set1_epi16(128);
+    __m128i alpha = _mm_shufflelo_epi16(pix, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm_or_si128(_mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3)), alpha_lanes);
+    const __m128i tmp = _mm_add_epi16(_mm_mullo_epi16(pix, alpha), round);
+    return _mm_srli_epi16(_mm_add_epi16(tmp, _mm_srli_epi16(tmp, 8)), 8);
+}
+
+// four channels in and out, no pshufb before ssse3
+template <bool Wide>
+auto convert_sse2(const void *src, unsigned char *dst, size_t count, bool swap, bool premultiply) -> size_t
+{
+    const __m128i rb_mask = _mm_set1_epi32(0x00ff00ff);
+    const __m128i ga_mask = _mm_set1_epi32(static_cast<int>(0xff00ff00U));
+    const __m128i zero = _mm_setzero_si128();
+    const size_t step = 4;
+
+    size_t i = 0;
+    for (; i + step <= count; i += step) {
+        __m128i pix;
+        if constexpr (Wide) {
+            const auto *ptr = static_cast<const uint16_t *>(src) + (i * 4);
+            const __m128i low = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr)), 8);
+            const __m128i high = _mm_srli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 8)), 8);
+            pix = _mm_packus_epi16(low, high);
+        } else {
+            pix = _mm_loadu_si128(reinterpret_cast<const __m128i *>(static_cast<const uint8_t *>(src) + (i * 4)));
+        }
+        if (swap) {
+            const __m128i red_blue = _mm_and_si128(pix, rb_mask);
+            pix = _mm_or_si128(_mm_and_si128(pix, ga_mask),
+                               _mm_or_si128(_mm_slli_epi32(red_blue, 16), _mm_srli_epi32(red_blue, 16)));
+        }
+        if (premultiply) {
+            pix = _mm_packus_epi16(premultiply_sse2(_mm_unpacklo_epi8(pix, zero)),
+                                   premultiply_sse2(_mm_unpackhi_epi8(pix, zero)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (i * 4)), pix);
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) inline auto premultiply_avx2(__m256i pix) -> __m256i
+{
+    const __m256i alpha_lanes = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0);
+    const __m256i round = _mm256_set1_epi16(128);
+    __m256i alpha = _mm256_shufflelo_epi16(pix, _MM_SHUFFLE(3, 3, 3, 3));
+    alpha = _mm256_or_si256(_mm256_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3)), alpha_lanes);
+    const __m256i tmp = _mm256_add_epi16(_mm256_mullo_epi16(pix, alpha), round);
+    return _mm256_srli_epi16(_mm256_add_epi16(tmp, _mm256_srli_epi16(tmp, 8)), 8);
+}
+
+// eight pixels per iteration, each 128-bit lane holds four of them
+template <int InCh, bool Wide, int OutCh>
+__attribute__((target("avx2"))) auto convert_avx2(const void *src, unsigned char *dst, size_t count, bool swap,
+                                                  bool premultiply) -> size_t
+{
+    const int unused = -1;
+    const __m256i expand = _mm256_setr_epi8(0, 1, 2, unused, 3, 4, 5, unused, 6, 7, 8, unused, 9, 10, 11, unused, 0,
+                                            1, 2, unused, 3, 4, 5, unused, 6, 7, 8, unused, 9, 10, 11, unused);
+    const __m256i compress = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, unused, unused, unused, unused,
+                                              0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, unused, unused, unused, unused);
+    const __m256i swizzle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5,
+                                             4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xff000000U));
+    const __m256i zero = _mm256_setzero_si256();
+    const size_t step = 8;
+    // three channel loads and stores touch 16 bytes for every 12 used
+    const size_t slack = (InCh == 3 || OutCh == 3) ? 2 : 0;
+
+    const auto *src8 = static_cast<const uint8_t *>(src);
+    const auto *src16 = static_cast<const uint16_t *>(src);
+
+    size_t i = 0;
+    for (; i + step + slack <= count; i += step) {
+        __m256i pix;
+        if constexpr (Wide) {
+            const auto *ptr = src16 + (i * 4);
+            const __m256i low = _mm256_srli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr)), 8);
+            const __m256i high = _mm256_srli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr + 16)), 8);
+            pix = _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), _MM_SHUFFLE(3, 1, 2, 0));
+        } else if constexpr (InCh == 3) {
+            const auto *ptr = src8 + (i * 3);
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr + 12));
+            pix = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+            pix = _mm256_or_si256(_mm256_shuffle_epi8(pix, expand), opaque);
+        } else {
+            pix = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src8 + (i * 4)));
+        }
+        if (swap) {
+            pix = _mm256_shuffle_epi8(pix, swizzle);
+        }
+        if (premultiply) {
+            pix = _mm256_packus_epi16(premultiply_avx2(_mm256_unpacklo_epi8(pix, zero)),
+                                      premultiply_avx2(_mm256_unpackhi_epi8(pix, zero)));
+        }
+        if constexpr (OutCh == 3) {
+            pix = _mm256_shuffle_epi8(pix, compress);
+            auto *ptr = dst + (i * 3);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(ptr), _mm256_castsi256_si128(pix));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(ptr + 12), _mm256_extracti128_si256(pix, 1));
+        } else {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + (i * 4)), pix);
+        }
+    }
+    return i;
+}
+
+template <int InCh, bool Wide>
+auto select_avx2(const Target &target) -> kernel_t
+{
+    if (target.channels == 3) {
+        return convert_avx2<InCh, Wide, 3>;
+    }
+    return convert_avx2<InCh, Wide, 4>;
+}
+
+auto select_kernel(const Format &format, const Target &target) -> kernel_t
+{
+    static const bool has_avx2 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+    }();
+    const bool wide = format.depth == wide_depth;
+
+    if (has_avx2) {
+        if (format.channels == 4) {
+            return wide ? select_avx2<4, true>(target) : select_avx2<4, false>(target);
+        }
+        if (format.channels == 3 && !wide) {
+            return select_avx2<3, false>(target);
+        }
+        return nullptr;
+    }
+    if (format.channels == 4 && target.channels == 4) {
+        return wide ? convert_sse2<true> : convert_sse2<false>;
+    }
+    return nullptr;
+}
+
+#elif defined(PIXEL_NEON)
+
+template <int InCh, bool Wide, int OutCh>
+auto convert_neon(const void *src, unsigned char *dst, size_t count, bool swap, bool premultiply) -> size_t
+{
+    const auto *src8 = static_cast<const uint8_t *>(src);
+    const auto *src16 = static_cast<const uint16_t *>(src);
+    const size_t step = 8;
+
+    size_t i = 0;
+    for (; i + step <= count; i += step) {
+        uint8x8x4_t pix;
+        if constexpr (Wide && InCh == 4) {
+            const uint16x8x4_t wide = vld4q_u16(src16 + (i * 4));
+            for (int chan = 0; chan < 4; ++chan) {
+                pix.val[chan] = vshrn_n_u16(wide.val[chan], 8);
+            }
+        } else if constexpr (Wide) {
+            const uint16x8x3_t wide = vld3q_u16(src16 + (i * 3));
+            for (int chan = 0; chan < 3; ++chan) {
+                pix.val[chan] = vshrn_n_u16(wide.val[chan], 8);
+            }
+            pix.val[3] = vdup_n_u8(255);
+        } else if constexpr (InCh == 4) {
+            pix = vld4_u8(src8 + (i * 4));
+        } else {
+            const uint8x8x3_t narrow = vld3_u8(src8 + (i * 3));
+            pix = {{narrow.val[0], narrow.val[1], narrow.val[2], vdup_n_u8(255)}};
+        }
+        if (swap) {
+            std::swap(pix.val[0], pix.val[2]);
+        }
+        if (premultiply) {
+            // same rounding as div255
+            for (int chan = 0; chan < 3; ++chan) {
+                const uint16x8_t tmp = vmull_u8(pix.val[chan], pix.val[3]);
+                pix.val[chan] = vraddhn_u16(tmp, vrshrq_n_u16(tmp, 8));
+            }
+        }
+        if constexpr (OutCh == 3) {
+            const uint8x8x3_t out = {{pix.val[0], pix.val[1], pix.val[2]}};
+            vst3_u8(dst + (i * 3), out);
+        } else {
+            vst4_u8(dst + (i * 4), pix);
+        }
+    }
+    return i;
+}
+
+template <int InCh, bool Wide>
+auto select_neon(const Target &target) -> kernel_t
+{
+    if (target.channels == 3) {
+        return convert_neon<InCh, Wide, 3>;
+    }
+    return convert_neon<InCh, Wide, 4>;
+}
+
+auto select_kernel(const Format &format, const Target &target) -> kernel_t
+{
+    const bool wide = format.depth == wide_depth;
+    if (format.channels == 4) {
+        return wide ? select_neon<4, true>(target) : select_neon<4, false>(target);
+    }
+    if (format.channels == 3) {
+        return wide ? select_neon<3, true>(target) : select_neon<3, false>(target);
+    }
+    return nullptr;
+}
+
+#else
+
+auto select_kernel(const Format & /*format*/, const Target & /*target*/) -> kernel_t
+{
+    return nullptr;
+}
+
+#endif
+
+} // namespace
+
+auto target_for(std::string_view output, bool has_alpha) -> Target
+{
+    // x11 and wayland buffers are premultiplied, chafa is told they are not
+    if (output == "x11" || output == "wayland") {
+        return {.channels = 4, .order = Order::bgr, .premultiply = true};
+    }
+    if (output == "chafa") {
+        return {.channels = 4, .order = Order::bgr, .premultiply = false};
+    }
+    // sixel has no transparency, blend against black
+    if (output == "sixel") {
+        return {.channels = 3, .order = Order::rgb, .premultiply = has_alpha};
+    }
+    return {.channels = has_alpha ? 4 : 3, .order = Order::rgb, .premultiply = false};
+}
+
+void convert(const void *src, const Format &format, unsigned char *dst, const Target &target, size_t count)
+{
+    size_t done = 0;
+    const auto kernel = select_kernel(format, target);
+    if (kernel != nullptr) {
+        done = kernel(src, dst, count, format.order != target.order, target.premultiply);
+    }
+    convert_scalar(src, format, dst, target, done, count);
+}
+
+} // namespace util::pixel
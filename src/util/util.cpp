@@ -22,6 +22,7 @@
 #include "util/socket.hpp"
 
 #include <array>
+#include <cerrno>
 #include <iomanip>
 #include <iostream>
 #include <memory>
@@ -35,17 +36,12 @@
 #  define EVP_MD_CTX_new EVP_MD_CTX_create
 #  define EVP_MD_CTX_free EVP_MD_CTX_destroy
 #endif
-#ifdef ENABLE_TURBOBASE64
-#  ifdef WITH_SYSTEM_TURBOBASE64
-#    include <turbobase64/turbob64.h>
-#  else
-#    include "turbob64.h"
-#  endif
-#endif
 #include <range/v3/all.hpp>
 
 #include <vips/vips8>
 
+#include <unistd.h>
+
 namespace fs = std::filesystem;
 using njson = nlohmann::json;
 
@@ -109,23 +105,6 @@ void util::send_socket_message(const std::string_view msg, const std::string_vie
     }
 }
 
-auto util::base64_encode(const unsigned char *input, size_t length) -> std::string
-{
-    const size_t bufsize = 4 * ((length + 2) / 3) + 1;
-    std::vector<char> res(bufsize, 0);
-    base64_encode_v2(input, length, reinterpret_cast<unsigned char *>(res.data()));
-    return {res.data()};
-}
-
-void util::base64_encode_v2(const unsigned char *input, size_t length, unsigned char *out)
-{
-#ifdef ENABLE_TURBOBASE64
-    tb64enc(input, length, out);
-#else
-    EVP_EncodeBlock(out, input, static_cast<int>(length));
-#endif
-}
-
 auto util::get_b2_hash_ssl(const std::string_view str) -> std::string
 {
     std::stringstream sstream;
@@ -149,6 +128,22 @@ auto util::get_b2_hash_ssl(const std::string_view str) -> std::string
     return sstream.str();
 }
 
+// bypasses the stream buffer, large outputs reach the terminal in a single call
+void util::write_stdout(std::string_view data)
+{
+    std::cout.flush();
+    while (!data.empty()) {
+        const auto written = write(STDOUT_FILENO, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+}
+
 void util::move_cursor(int row, int col)
 {
     std::cout << "\033[" << row << ";" << col << "f" << std::flush;
@@ -164,11 +159,6 @@ void util::restore_cursor_position()
     std::cout << "\0338" << std::flush;
 }
 
-auto util::get_cache_file_save_location(const fs::path &path) -> std::string
-{
-    return fmt::format("{}{}{}", get_cache_path(), get_b2_hash_ssl(path.string()), path.extension().string());
-}
-
 void util::benchmark(const std::function<void(void)> &func)
 {
     using std::chrono::duration;
@@ -22,6 +22,7 @@
 
 #include <range/v3/all.hpp>
 #include <xcb/res.h>
+#include <xcb/shm.h>
 #include <xcb/xcb.h>
 
 #include <algorithm>
@@ -56,6 +57,11 @@ X11Util::~X11Util()
     }
 }
 
+namespace
+{
+constexpr uint8_t send_event_mask = 0x80;
+} // namespace
+
 auto X11Util::get_server_window_ids() const -> std::vector<xcb_window_t>
 {
     const int num_clients = 256;
@@ -91,10 +97,10 @@ auto X11Util::get_server_window_ids() const -> std::vector<xcb_window_t>
     return windows;
 }
 
-auto X11Util::get_pid_window_map() const -> std::unordered_map<uint32_t, xcb_window_t>
+auto X11Util::query_pids(const std::vector<xcb_window_t> &windows) const
+    -> std::vector<std::pair<xcb_window_t, uint32_t>>
 {
-    const auto windows = get_server_window_ids();
-    std::unordered_map<uint32_t, xcb_window_t> res;
+    std::vector<std::pair<xcb_window_t, uint32_t>> res;
     std::vector<xcb_res_query_client_ids_cookie_t> cookies;
     res.reserve(windows.size());
     cookies.reserve(windows.size());
@@ -109,21 +115,175 @@ auto X11Util::get_pid_window_map() const -> std::unordered_map<uint32_t, xcb_win
     }
 
     // process replies
-    auto win_iter = windows.cbegin();
-    for (const auto cookie : cookies) {
-        const auto reply =
-            unique_C_ptr<xcb_res_query_client_ids_reply_t>{xcb_res_query_client_ids_reply(connection, cookie, nullptr)};
+    for (size_t i = 0; i < cookies.size(); ++i) {
+        const auto reply = unique_C_ptr<xcb_res_query_client_ids_reply_t>{
+            xcb_res_query_client_ids_reply(connection, cookies[i], nullptr)};
         if (!reply) {
             continue;
         }
         const auto iter = xcb_res_query_client_ids_ids_iterator(reply.get());
-        const auto pid = *xcb_res_client_id_value_value(iter.data);
-        res.insert_or_assign(pid, *win_iter);
-        std::advance(win_iter, 1);
+        res.emplace_back(windows[i], *xcb_res_client_id_value_value(iter.data));
+    }
+    return res;
+}
+
+auto X11Util::get_pid_window_map() const -> std::unordered_map<uint32_t, xcb_window_t>
+{
+    std::unordered_map<uint32_t, xcb_window_t> res;
+    if (!tracking) {
+        for (const auto &[window, pid] : query_pids(get_server_window_ids())) {
+            res.insert_or_assign(pid, window);
+        }
+        return res;
+    }
+
+    const std::scoped_lock lock{index_mutex};
+    if (!indexed) {
+        index_windows();
+        indexed = true;
+    }
+    resolve_pending_windows();
+
+    // windows inside window manager frames are destroyed without an event
+    // reaching the root, so the chosen ones are checked before use
+    while (true) {
+        // a pid often owns several windows, like the untracked walk the latest
+        // one wins, independently of the hash order
+        res.clear();
+        std::unordered_map<uint32_t, uint64_t> orders;
+        for (const auto &[window, tracked] : window_pids) {
+            const auto [order, inserted] = orders.try_emplace(tracked.pid, tracked.order);
+            if (inserted || tracked.order > order->second) {
+                order->second = tracked.order;
+                res.insert_or_assign(tracked.pid, window);
+            }
+        }
+        std::vector<xcb_window_t> chosen;
+        chosen.reserve(res.size());
+        for (const auto &[pid, window] : res) {
+            chosen.push_back(window);
+        }
+        const auto destroyed = find_destroyed(chosen);
+        if (destroyed.empty()) {
+            return res;
+        }
+        for (const auto window : destroyed) {
+            window_pids.erase(window);
+        }
+    }
+}
+
+void X11Util::track_windows()
+{
+    tracking = true;
+}
+
+// only records what changed, the windows are queried on the next lookup
+void X11Util::handle_event(const xcb_generic_event_t *event)
+{
+    const std::scoped_lock lock{index_mutex};
+    if (!indexed) {
+        return;
+    }
+    switch (event->response_type & ~send_event_mask) {
+        case XCB_CREATE_NOTIFY: {
+            const auto *create = reinterpret_cast<const xcb_create_notify_event_t *>(event);
+            if (!is_own_window(create->window)) {
+                pending_windows.push_back(create->window);
+            }
+            break;
+        }
+        case XCB_DESTROY_NOTIFY: {
+            const auto *destroy = reinterpret_cast<const xcb_destroy_notify_event_t *>(event);
+            window_pids.erase(destroy->window);
+            std::erase(pending_windows, destroy->window);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void X11Util::index_windows() const
+{
+    // top level windows are created as children of the root, also the ones a
+    // window manager later moves into a frame. selecting before walking the
+    // tree means none is created unnoticed in between
+    const uint32_t event_mask = XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY;
+    xcb_change_window_attributes(connection, screen->root, XCB_CW_EVENT_MASK, &event_mask);
+    add_windows(get_server_window_ids());
+}
+
+void X11Util::add_windows(const std::vector<xcb_window_t> &windows) const
+{
+    for (const auto &[window, pid] : query_pids(windows)) {
+        window_pids.insert_or_assign(window, TrackedWindow{.pid = pid, .order = next_order++});
+    }
+}
+
+// new windows are added once they have a class or name, the others are
+// looked at again on the next lookup until they are destroyed
+void X11Util::resolve_pending_windows() const
+{
+    if (pending_windows.empty()) {
+        return;
+    }
+    std::vector<std::pair<xcb_get_property_cookie_t, xcb_get_property_cookie_t>> cookies;
+    cookies.reserve(pending_windows.size());
+    for (const auto window : pending_windows) {
+        cookies.emplace_back(xcb_get_property(connection, 0, window, XCB_ATOM_WM_CLASS, XCB_ATOM_ANY, 0, 4),
+                             xcb_get_property(connection, 0, window, XCB_ATOM_WM_NAME, XCB_ATOM_ANY, 0, 4));
+    }
+
+    std::vector<xcb_window_t> complete;
+    std::vector<xcb_window_t> waiting;
+    for (size_t i = 0; i < cookies.size(); ++i) {
+        bool exists = true;
+        bool has_identity = false;
+        for (const auto cookie : {cookies[i].first, cookies[i].second}) {
+            xcb_generic_error_t *err = nullptr;
+            const auto reply =
+                unique_C_ptr<xcb_get_property_reply_t>{xcb_get_property_reply(connection, cookie, &err)};
+            const auto err_owner = unique_C_ptr<xcb_generic_error_t>{err};
+            exists = exists && reply != nullptr;
+            has_identity = has_identity || (reply && xcb_get_property_value_length(reply.get()) != 0);
+        }
+        if (has_identity) {
+            complete.push_back(pending_windows[i]);
+        } else if (exists) {
+            waiting.push_back(pending_windows[i]);
+        }
+    }
+    pending_windows = std::move(waiting);
+    add_windows(complete);
+}
+
+auto X11Util::find_destroyed(const std::vector<xcb_window_t> &windows) const -> std::vector<xcb_window_t>
+{
+    std::vector<xcb_get_window_attributes_cookie_t> cookies;
+    cookies.reserve(windows.size());
+    for (const auto window : windows) {
+        cookies.push_back(xcb_get_window_attributes(connection, window));
+    }
+    std::vector<xcb_window_t> res;
+    for (size_t i = 0; i < cookies.size(); ++i) {
+        xcb_generic_error_t *err = nullptr;
+        const auto reply = unique_C_ptr<xcb_get_window_attributes_reply_t>{
+            xcb_get_window_attributes_reply(connection, cookies[i], &err)};
+        const auto err_owner = unique_C_ptr<xcb_generic_error_t>{err};
+        if (!reply) {
+            res.push_back(windows[i]);
+        }
     }
     return res;
 }
 
+auto X11Util::is_own_window(xcb_window_t window) const -> bool
+{
+    const auto *setup = xcb_get_setup(connection);
+    return (window & ~setup->resource_id_mask) == setup->resource_id_base;
+}
+
 auto X11Util::window_has_properties(xcb_window_t window, std::initializer_list<xcb_atom_t> properties) const -> bool
 {
     std::vector<xcb_get_property_cookie_t> cookies;
@@ -169,3 +329,22 @@ auto X11Util::get_parent_window(int pid) const -> xcb_window_t
 
     return 0;
 }
+
+auto X11Util::has_shm() const -> bool
+{
+    // file descriptors can only be passed over a local socket, xcb closes
+    // the connection when that fails
+    const auto display = os::getenv("DISPLAY").value_or("");
+    if (!display.starts_with(':') && !display.starts_with("unix:") && !display.starts_with('/')) {
+        return false;
+    }
+    const auto cookie = xcb_shm_query_version(connection);
+    const auto reply =
+        unique_C_ptr<xcb_shm_query_version_reply_t>{xcb_shm_query_version_reply(connection, cookie, nullptr)};
+    if (!reply) {
+        return false;
+    }
+    // attaching file descriptors was added in 1.2
+    const int fd_minor_version = 2;
+    return reply->major_version > 1 || (reply->major_version == 1 && reply->minor_version >= fd_minor_version);
+}
@@ -0,0 +1,122 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// checks that base64_encode_v2 matches OpenSSL for every length up to
+// max_check_length and every alignment of the input, which covers the
+// vector kernels together with the scalar tail. unless --check-only is
+// given it then times the encoders on a large buffer
+
+#include "util.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include <openssl/evp.h>
+
+#ifdef ENABLE_TURBOBASE64
+#  ifdef WITH_SYSTEM_TURBOBASE64
+#    include <turbobase64/turbob64.h>
+#  else
+#    include "turbob64.h"
+#  endif
+#endif
+
+namespace
+{
+
+constexpr size_t max_check_length = 4096;
+constexpr size_t max_alignment = 32;
+constexpr size_t benchmark_size = 64 * 1024 * 1024;
+
+auto random_bytes(size_t length) -> std::vector<unsigned char>
+{
+    std::mt19937 rng(util::generate_random_number<uint32_t>(0));
+    std::uniform_int_distribution<unsigned short> dist(0, std::numeric_limits<unsigned char>::max());
+    std::vector<unsigned char> res(length);
+    for (auto &byte : res) {
+        byte = static_cast<unsigned char>(dist(rng));
+    }
+    return res;
+}
+
+auto encode_evp(const unsigned char *input, size_t length) -> std::vector<unsigned char>
+{
+    // EVP_EncodeBlock adds a terminator
+    std::vector<unsigned char> res(util::base64_encoded_size(length) + 1);
+    EVP_EncodeBlock(res.data(), input, static_cast<int>(length));
+    res.pop_back();
+    return res;
+}
+
+auto encode_v2(const unsigned char *input, size_t length) -> std::vector<unsigned char>
+{
+    // turbo-base64 may write a terminator too
+    std::vector<unsigned char> res(util::base64_encoded_size(length) + 1);
+    util::base64_encode_v2(input, length, res.data());
+    res.pop_back();
+    return res;
+}
+
+auto check() -> bool
+{
+    const auto input = random_bytes(max_check_length + max_alignment);
+    for (size_t offset = 0; offset < max_alignment; ++offset) {
+        for (size_t length = 0; length <= max_check_length; ++length) {
+            const auto *data = input.data() + offset;
+            if (encode_v2(data, length) != encode_evp(data, length)) {
+                std::cerr << "base64_encode_v2 differs from EVP_EncodeBlock for length " << length << " at offset "
+                          << offset << "\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void run_benchmarks()
+{
+    const auto input = random_bytes(benchmark_size);
+    std::vector<unsigned char> out(util::base64_encoded_size(benchmark_size) + 1);
+
+    std::cout << "base64_encode_v2: ";
+    util::benchmark([&] { util::base64_encode_v2(input.data(), input.size(), out.data()); });
+
+    std::cout << "EVP_EncodeBlock: ";
+    util::benchmark([&] { EVP_EncodeBlock(out.data(), input.data(), static_cast<int>(input.size())); });
+
+#ifdef ENABLE_TURBOBASE64
+    std::cout << "tb64enc: ";
+    util::benchmark([&] { tb64enc(input.data(), input.size(), out.data()); });
+#endif
+}
+
+} // namespace
+
+auto main(int argc, char **argv) -> int
+{
+    if (!check()) {
+        return 1;
+    }
+    const bool check_only = argc > 1 && std::string_view{argv[1]} == "--check-only";
+    if (!check_only) {
+        run_benchmarks();
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// an animation whose decoder fails must end instead of waiting forever for
+// the frame that never comes
+
+#include "image/framebuffer.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include <glib.h>
+#include <spdlog/sinks/null_sink.h>
+#include <spdlog/spdlog.h>
+
+namespace
+{
+
+auto make_frame(int index) -> std::shared_ptr<const Frame>
+{
+    const size_t size = 4;
+    auto frame = std::make_shared<Frame>();
+    frame->data.reset(static_cast<unsigned char *>(g_malloc(size)));
+    frame->size = size;
+    frame->index = index;
+    return frame;
+}
+
+// waits for the decoder thread, which is never expected to take long
+auto wait_for_frame(FrameBuffer &frames) -> FrameStatus
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (std::chrono::steady_clock::now() < deadline) {
+        const auto [status, frame] = frames.next();
+        if (status != FrameStatus::pending) {
+            return status;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return FrameStatus::pending;
+}
+
+} // namespace
+
+auto main() -> int
+{
+    spdlog::create<spdlog::sinks::null_sink_mt>("main");
+
+    const int num_frames = 4;
+    const int failing_frame = 2;
+    // the loop budget is too small to keep, so frames only come from the decoder
+    const size_t loop_budget = 1;
+    FrameBuffer frames(num_frames, make_frame(0), [](int index) {
+        if (index == failing_frame) {
+            throw std::runtime_error("corrupt frame");
+        }
+        return make_frame(index);
+    }, loop_budget);
+
+    if (wait_for_frame(frames) != FrameStatus::ready) {
+        std::cerr << "the frame before the failing one was not delivered\n";
+        return 1;
+    }
+    if (wait_for_frame(frames) != FrameStatus::ended) {
+        std::cerr << "the animation did not end after its decoder failed\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Display images inside a terminal
+// Copyright (C) 2023  JustKidding
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+// windows created after the pid map was built must be found through the
+// events alone, also when their class and name are set before they can be
+// watched
+
+#include "util/ptr.hpp"
+#include "util/x11.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <tuple>
+
+#include <unistd.h>
+#include <xcb/xcb.h>
+
+namespace
+{
+
+constexpr int skip_test = 77;
+
+auto create_named_window(xcb_connection_t *connection) -> xcb_window_t
+{
+    const auto *screen = xcb_setup_roots_iterator(xcb_get_setup(connection)).data;
+    const auto window = xcb_generate_id(connection);
+    xcb_create_window(connection, XCB_COPY_FROM_PARENT, window, screen->root, 0, 0, 1, 1, 0,
+                      XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, 0, nullptr);
+
+    // sent together with the creation, before anyone can select events on it
+    const int bits_in_char = 8;
+    using std::string_view_literals::operator""sv;
+    constexpr auto name = "ueberzugpp-test"sv;
+    // instance and class, each terminated
+    constexpr auto wm_class = "ueberzugpp-test\0ueberzugpp-test\0"sv;
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, bits_in_char,
+                        name.size(), name.data());
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING,
+                        bits_in_char, wm_class.size(), wm_class.data());
+    xcb_flush(connection);
+    return window;
+}
+
+} // namespace
+
+auto main() -> int
+{
+    auto *connection = xcb_connect(nullptr, nullptr);
+    auto *client = xcb_connect(nullptr, nullptr);
+    if (xcb_connection_has_error(connection) != 0 || xcb_connection_has_error(client) != 0) {
+        std::cerr << "no X server, skipping\n";
+        xcb_disconnect(connection);
+        xcb_disconnect(client);
+        return skip_test;
+    }
+
+    X11Util xutil(connection);
+    xutil.track_windows();
+    // builds the index and starts watching the tree
+    std::ignore = xutil.get_pid_window_map();
+
+    const auto window = create_named_window(client);
+    const auto pid = static_cast<uint32_t>(getpid());
+
+    bool found = false;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!found && std::chrono::steady_clock::now() < deadline) {
+        auto event = unique_C_ptr<xcb_generic_event_t>{xcb_poll_for_event(connection)};
+        if (!event) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+        xutil.handle_event(event.get());
+        const auto pid_window_map = xutil.get_pid_window_map();
+        const auto entry = pid_window_map.find(pid);
+        found = entry != pid_window_map.end() && entry->second == window;
+    }
+
+    xcb_destroy_window(client, window);
+    xcb_disconnect(client);
+    xcb_disconnect(connection);
+    if (!found) {
+        std::cerr << "window " << window << " created with its properties set is missing from the pid map\n";
+        return 1;
+    }
+    return 0;
+}